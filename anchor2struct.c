@@ -6,6 +6,7 @@
  * Pointers of anchor structs、pilotscope data struct and enumerate type:
  *      subquery_card_fetcher_anchor
  *      card_replace_anchor
+ *      selectivity_replace_anchor
  *      execution_time_fetch_anchor
  *      record_fetch_anchor
  *      pilot_transdata
@@ -19,15 +20,19 @@
  *      enablePilotscope
  *      subquerycardfetcher_time
  *      cardreplace_time
+ *      selectivityreplace_time
  *      executiontimefetch_time
  *      anchor_time_num
  *      port
  *      host
+ *      planning_cycle
+ *      PilotScopeQueryContext
  * 
  * Some reflection tables are used in transforming json to strut wih the help
  * of "cson.h":
  *      Subquery_Card_Fetcher_Anchor_ref_tbl
  *      Card_Replace_Anchor_ref_tbl
+ *      Selectivity_Replace_Anchor_ref_tbl
  *      Execution_Time_Fetch_Anchor_ref_tbl
  *      Record_Fetch_Anchor_ref_tbl
  * 
@@ -35,6 +40,12 @@
  * to json and store some data of anchors into hashtable in order to deal with some
  * special anchors.
  * 
+ * Everything pilotscope keeps for an annotated query, including the anchor structs,
+ * pilot_transdata, the hashtables and the objects of cJSON and cson, is allocated in
+ * PilotScopeQueryContext. The context is reset when the next annotated query starts
+ * and when end_anchor is done, so that the memory of a session stays flat however
+ * many queries it runs.
+ * 
  * Copyright (c) 2023, Damo Academy of Alibaba Group
  * -------------------------------------------------------------------------
  */
@@ -45,6 +56,8 @@
 #include <stdbool.h>
 #include "postgres.h"
 #include "time.h"
+#include "access/xact.h"
+#include "utils/memutils.h"
 #include "utils/cJSON.h"
 #include "utils/cson.h"
 #include "anchor2struct.h"
@@ -68,25 +81,23 @@
  */
 #define get_json_from_cjson(root) cJSON_Print(root);
 
-/*
- * free struct 
- */
-#define free_struct(struct_name) if(struct_name!=NULL)\
-    {\
-        pfree(struct_name);\
-    }
-
 static char* pilottransdata_to_json();
 static void put_aimodel_subquery2card();
+static void put_aimodel_clause2selectivity(Hashtable* table, const char* key, const char* value);
 static void cJSON_AddStringArrayToObject(cJSON*root,char* array_name,char** array,int array_size);
 static void store_array_num_for_pilottransdata();
 static double get_curr_timestamp();
-static void free_all_struct();
+static void* pilotscope_malloc(size_t size);
+static void pilotscope_free(void* pointer);
+static void pilotscope_xact_callback(XactEvent event, void* arg);
+static void pilotscope_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
+                                        SubTransactionId parentSubid, void* arg);
 /*
  * Some global vars relative to anchor operation.
  */
 SubqueryCardFetcherAnchor *subquery_card_fetcher_anchor;
 CardReplaceAnchor *card_replace_anchor;
+SelectivityReplaceAnchor *selectivity_replace_anchor;
 ExecutionTimeFetchAnchor *execution_time_fetch_anchor ;
 RecordFetchAnchor *record_fetch_anchor;
 PilotTransData *pilot_transdata;
@@ -99,11 +110,29 @@ int enableSend;
 int enablePilotscope;
 double subquerycardfetcher_time;
 double cardreplace_time;
+double selectivityreplace_time;
 double executiontimefetch_time;
 double parser_time_;
 int anchor_time_num;
 int port;
 char* host;
+Hashtable* selectivity_table;
+
+/*
+ * Counts the calls of pilotscope_standard_planner. The per-planning memos in the
+ * optimizer remember the cycle they were built in and start over once it changes, so
+ * that nothing allocated by a previous planning is touched again.
+ */
+int planning_cycle = 0;
+
+/*
+ * The memory context of the annotated query being processed, see init_pilotscope_query_context.
+ */
+MemoryContext PilotScopeQueryContext = NULL;
+
+// the subtransaction the annotated query being processed started in
+static SubTransactionId query_subid = InvalidSubTransactionId;
+static AnchorName anchor_name;
 
 /*
  * Define some reflection tables(refer to 'cson'). We need to state every varibles in the struct.
@@ -128,6 +157,18 @@ reflect_item_t Card_Replace_Anchor_ref_tbl[] = {
     _property_end()
 };
 
+reflect_item_t Selectivity_Replace_Anchor_ref_tbl[] = {
+    _property_bool(SelectivityReplaceAnchor, enable),
+    _property_string(SelectivityReplaceAnchor, name),
+
+    _property_int_ex(SelectivityReplaceAnchor, subquery_num, _ex_args_all),
+    _property_array_string(SelectivityReplaceAnchor, subquery, char*, subquery_num),
+
+    _property_int_ex(SelectivityReplaceAnchor, selectivity_num, _ex_args_all),
+    _property_array_real(SelectivityReplaceAnchor, selectivity, double, selectivity_num),
+    _property_end()
+};
+
 reflect_item_t Execution_Time_Fetch_Anchor_ref_tbl[] = {
     _property_bool(ExecutionTimeFetchAnchor, enable),
     _property_string(ExecutionTimeFetchAnchor, name),
@@ -146,18 +187,23 @@ reflect_item_t Record_Fetch_Anchor_ref_tbl[] = {
  */
  void init_some_vars()
  {  
+    // forget the former query
+    reset_pilotscope_query_context();
+    query_subid = GetCurrentSubTransactionId();
+
     // init pilottransdata
     init_struct(pilot_transdata,PilotTransData)
 
     // init other vars
-    AnchorName an                   = UNKNOWN_ANCHOR;
-    ANCHOR_NAME                     = &an;
+    anchor_name                     = UNKNOWN_ANCHOR;
+    ANCHOR_NAME                     = &anchor_name;
     anchor_num                      = 0;
     enableSend                      = 1;
     enableTerminate                 = false;
     enablePilotscope                = 1;
     subquerycardfetcher_time        = 0.0;
     cardreplace_time                = 0.0;
+    selectivityreplace_time         = 0.0;
     executiontimefetch_time         = 0.0;
     parser_time_                    = 0.0;
     anchor_time_num                 = 0;
@@ -173,6 +219,7 @@ void anchorname_to_enu(char* anchorname)
 {
     set_anchor_name_for_enu("SUBQUERY_CARD_FETCH_ANCHOR", SUBQUERY_CARD_FETCH_ANCHOR);
     set_anchor_name_for_enu("CARD_REPLACE_ANCHOR", CARD_REPLACE_ANCHOR);
+    set_anchor_name_for_enu("SELECTIVITY_REPLACE_ANCHOR", SELECTIVITY_REPLACE_ANCHOR);
     set_anchor_name_for_enu("EXECUTION_TIME_FETCH_ANCHOR", EXECUTION_TIME_FETCH_ANCHOR);
     set_anchor_name_for_enu("RECORD_FETCH_ANCHOR", RECORD_FETCH_ANCHOR);
     set_anchor_name_for_enu("PHYSICAL_PLAN_FETCH_ANCHOR", PHYSICAL_PLAN_FETCH_ANCHOR);
@@ -246,14 +293,16 @@ void end_anchor()
         send_and_receive(string_of_pilottransdata);
 
         // free
-        free(string_of_pilottransdata); 
-        free_all_struct();  
+        cJSON_free(string_of_pilottransdata);
     }
     else
     {
         elog(INFO,"No fetch anchor and no need to send!");
     }
 
+    // the query needs nothing of pilotscope any more
+    reset_pilotscope_query_context();
+
     /*
      * If enableTerminate == 1, we will terminate the program and back to psql. Note that we don't close
      * the session but just back to psql with the help of ereport.
@@ -310,6 +359,50 @@ static void put_aimodel_subquery2card(Hashtable* table, const char* key, const c
     
 }
 
+/*
+ * The same hash operation for selectivity_replace_anchor. The keys are fingerprints
+ * of clause sets, which are written in the same form as the subqueries of
+ * card_replace_anchor (see "utils/subplanquery.c").
+ */
+
+// store_aimodel_clause2selectivity
+void store_aimodel_clause2selectivity()
+{
+    /*
+     * There may be many thousands of selectivities, so unlike the card table we size the
+     * table linearly: the next power of two of twice their number keeps the chains short.
+     */
+    table_size = 16;
+    while(table_size < 2 * selectivity_replace_anchor->selectivity_num && table_size < (1 << 30))
+    {
+        table_size *= 2;
+    }
+    selectivity_table = create_hashtable();
+
+    for(int i = 0;i<selectivity_replace_anchor->selectivity_num;i++)
+    {
+        char selectivity[CHAR_LEN_FOR_NUM];
+        sprintf(selectivity,"%.10f",selectivity_replace_anchor->selectivity[i]);
+        put_aimodel_clause2selectivity(selectivity_table, selectivity_replace_anchor->subquery[i], selectivity);
+    }
+}
+
+// get_aimodel_clause2selectivity
+char* get_aimodel_clause2selectivity(const char* key)
+{
+    if(selectivity_table == NULL)
+    {
+        return NULL;
+    }
+    return get(selectivity_table, key);
+}
+
+// put_aimodel_clause2selectivity
+static void put_aimodel_clause2selectivity(Hashtable* table, const char* key, const char* value)
+{
+    put(table, key, value);
+}
+
 // add string array to cjson object
 static void cJSON_AddStringArrayToObject(cJSON*root,char* array_name,char** array,int array_size)
 {
@@ -347,14 +440,88 @@ static double get_curr_timestamp()
     return http_time;
 }
 
-// free all struct
-static void free_all_struct()
+/*
+ * Create PilotScopeQueryContext and let cJSON and cson allocate in it. Called once
+ * by _PG_init.
+ */
+void init_pilotscope_query_context()
 {
-    free_struct(pilot_transdata);
-    free_struct(subquery_card_fetcher_anchor);
-    free_struct(card_replace_anchor);
-    free_struct(execution_time_fetch_anchor);
-    free_struct(record_fetch_anchor);
+    cJSON_Hooks hooks;
 
-    return;
+    if(PilotScopeQueryContext == NULL)
+    {
+        PilotScopeQueryContext = AllocSetContextCreate(TopMemoryContext,
+                                                       "PilotScopeQueryContext",
+                                                       ALLOCSET_DEFAULT_SIZES);
+        RegisterXactCallback(pilotscope_xact_callback, NULL);
+        RegisterSubXactCallback(pilotscope_subxact_callback, NULL);
+    }
+
+    hooks.malloc_fn = pilotscope_malloc;
+    hooks.free_fn   = pilotscope_free;
+    cJSON_InitHooks(&hooks);
+    csonInitHooks(pilotscope_malloc, pilotscope_free);
+}
+
+/*
+ * Free everything of the current annotated query at once, and forget the pointers
+ * into it so that nobody takes them for the next query.
+ */
+void reset_pilotscope_query_context()
+{
+    MemoryContextReset(PilotScopeQueryContext);
+
+    pilot_transdata              = NULL;
+    subquery_card_fetcher_anchor = NULL;
+    card_replace_anchor          = NULL;
+    selectivity_replace_anchor   = NULL;
+    execution_time_fetch_anchor  = NULL;
+    record_fetch_anchor          = NULL;
+    table                        = NULL;
+    selectivity_table            = NULL;
+    host                         = NULL;
+}
+
+/*
+ * An annotated query that fails while planning or executing never reaches end_anchor,
+ * so we reset at the abort of its transaction, or of its subtransaction below (e.g. a
+ * PL/pgSQL EXCEPTION block). Otherwise the hooks would take its anchors for those of
+ * the next query.
+ */
+static void pilotscope_xact_callback(XactEvent event, void* arg)
+{
+    if(event == XACT_EVENT_ABORT || event == XACT_EVENT_PARALLEL_ABORT)
+    {
+        reset_pilotscope_query_context();
+        anchor_num = 0;
+    }
+}
+
+static void pilotscope_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
+                                        SubTransactionId parentSubid, void* arg)
+{
+    /*
+     * Subtransactions started by the query itself, e.g. by a function evaluated while
+     * planning, may fail without failing the query; their ids are above query_subid.
+     */
+    if(event == SUBXACT_EVENT_ABORT_SUB && mySubid <= query_subid)
+    {
+        reset_pilotscope_query_context();
+        anchor_num = 0;
+    }
+}
+
+// allocator of cJSON and cson
+static void* pilotscope_malloc(size_t size)
+{
+    return MemoryContextAlloc(PilotScopeQueryContext, size);
+}
+
+// deallocator of cJSON and cson
+static void pilotscope_free(void* pointer)
+{
+    if(pointer != NULL)
+    {
+        pfree(pointer);
+    }
 }
\ No newline at end of file
@@ -13,8 +13,7 @@
 #include "utils/cson.h"
 
 // init structs including anchor struct and pilottransdata struct
-#define init_struct(anchor,type) anchor = (type*)palloc(sizeof(type)); \
-        memset(anchor,0,sizeof(*anchor));
+#define init_struct(anchor,type) anchor = (type*)MemoryContextAllocZero(PilotScopeQueryContext,sizeof(type));
 
 // store string for num
 // avoid redefinition caused by "#define"
@@ -22,7 +21,7 @@
         char num_string[CHAR_LEN_FOR_NUM]; \
         sprintf(num_string, "%.6f", num);\
         int num_string_length = strlen(num_string);\
-        store_var = (char*)palloc((num_string_length+1)*sizeof(char));  \
+        store_var = (char*)MemoryContextAlloc(PilotScopeQueryContext,(num_string_length+1)*sizeof(char));  \
         strcpy(store_var,num_string);}
 
 // store string
@@ -30,11 +29,12 @@
 #define store_string(string_object,store_var) if(1)\
     {\
         int string_length = strlen(string_object);\
-        store_var = (char*)palloc((string_length+1)*sizeof(char));  \
+        store_var = (char*)MemoryContextAlloc(PilotScopeQueryContext,(string_length+1)*sizeof(char));  \
         strcpy(store_var,string_object);}
 
 // realloc char**
-#define relloc_string_array_object(string_array_object,new_size) string_array_object = (char**)realloc(string_array_object,new_size*sizeof(char*));
+#define relloc_string_array_object(string_array_object,new_size) string_array_object = (char**)(string_array_object == NULL ? \
+        MemoryContextAlloc(PilotScopeQueryContext,new_size*sizeof(char*)) : repalloc(string_array_object,new_size*sizeof(char*)));
 
 // back_to_psql
 #define back_to_psql(message) ereport(ERROR,(errmsg(message)));
@@ -82,6 +82,16 @@ typedef struct
     size_t  card_num;
 }CardReplaceAnchor;
 
+typedef struct 
+{
+    int enable;
+    char* name;
+    char** subquery;
+    double* selectivity;
+    size_t  subquery_num;
+    size_t  selectivity_num;
+}SelectivityReplaceAnchor;
+
 typedef struct 
 {
     int enable;
@@ -99,6 +109,7 @@ typedef enum
 {
     SUBQUERY_CARD_FETCH_ANCHOR,
     CARD_REPLACE_ANCHOR,
+    SELECTIVITY_REPLACE_ANCHOR,
     EXECUTION_TIME_FETCH_ANCHOR,
     RECORD_FETCH_ANCHOR,
     PHYSICAL_PLAN_FETCH_ANCHOR,
@@ -111,11 +122,13 @@ typedef enum
 extern PilotTransData* pilot_transdata;
 extern SubqueryCardFetcherAnchor* subquery_card_fetcher_anchor;
 extern CardReplaceAnchor* card_replace_anchor;
+extern SelectivityReplaceAnchor* selectivity_replace_anchor;
 extern ExecutionTimeFetchAnchor* execution_time_fetch_anchor;
 extern RecordFetchAnchor *record_fetch_anchor;
 extern AnchorName* ANCHOR_NAME;
 extern reflect_item_t Subquery_Card_Fetcher_Anchor_ref_tbl[];
 extern reflect_item_t Card_Replace_Anchor_ref_tbl[];
+extern reflect_item_t Selectivity_Replace_Anchor_ref_tbl[];
 extern reflect_item_t Execution_Time_Fetch_Anchor_ref_tbl[] ;
 extern reflect_item_t Record_Fetch_Anchor_ref_tbl[];
 
@@ -124,6 +137,7 @@ extern int anchor_num;
 extern int enableTerminate;
 extern double subquerycardfetcher_time;
 extern double cardreplace_time;
+extern double selectivityreplace_time;
 extern double executiontimefetch_time;
 extern double parser_time_;
 extern int enablePilotscope;
@@ -132,11 +146,18 @@ extern int subquery_count;
 extern int port;
 extern char* host;
 extern int enableSend;
+extern int planning_cycle;
+extern Hashtable* selectivity_table;
+extern MemoryContext PilotScopeQueryContext;
 
 // function
+extern void init_pilotscope_query_context();
+extern void reset_pilotscope_query_context();
 extern void init_some_vars();
 extern void end_anchor();
 extern char* get_aimodel_subquery2card(Hashtable* table, const char* key);
 extern void store_aimodel_subquery2card();
+extern char* get_aimodel_clause2selectivity(const char* key);
+extern void store_aimodel_clause2selectivity();
 
 #endif 
\ No newline at end of file
@@ -49,6 +49,60 @@
 #include "rewrite/rewriteManip.h"
 #include "utils/lsyscache.h"
 
+/** modification start **/
+#include "anchor2struct.h"
+#include "optimizer/pilotscope_paths.h"
+#include "port/pg_bitutils.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+#include "utils/pilotscope_guc.h"
+#include "utils/card_callback.h"
+
+/*
+ * State of the DPccp join enumeration of one standard_join_search.
+ *
+ * The nodes of the join graph are the initial rels, numbered as in the
+ * initial_rels list, and sets of nodes are kept as 64-bit masks.
+ */
+typedef struct DPccpState
+{
+	PlannerInfo *root;
+	int			nnodes;
+	RelOptInfo **nodes;			/* the initial rels */
+	uint64	   *adj;			/* neighborhood of each node */
+	HTAB	   *rels;			/* node set -> DPccpRel */
+} DPccpState;
+
+typedef struct DPccpRel
+{
+	uint64		nodes;			/* hash key --- MUST BE FIRST */
+	RelOptInfo *rel;
+} DPccpRel;
+
+/*
+ * Upper bound of the cost of the join search in progress in bounded pruning
+ * mode, or -1.  It is only trusted during the planning cycle that set it.
+ */
+static Cost join_cost_bound = -1;
+static int	join_cost_bound_cycle = 0;
+
+/*
+ * A node of the join tree built by greedy operator ordering.  Leaves are the
+ * initial rels of the join search.
+ */
+typedef struct GreedyJoinTree
+{
+	Relids		relids;
+	int			nleaves;
+	RelOptInfo *rel;			/* the initial rel, for leaves only */
+	struct GreedyJoinTree *left;
+	struct GreedyJoinTree *right;
+} GreedyJoinTree;
+
+/* Upper limit of pilotscope.greedy_join_window, see plan_greedy_join_tree */
+#define GREEDY_JOIN_MAX_WINDOW	10
+/** modification end **/
+
 
 /* results of subquery_is_pushdown_safe */
 typedef struct pushdown_safety_info
@@ -142,6 +196,40 @@ static void recurse_push_qual(Node *setOp, Query *topquery,
 							  RangeTblEntry *rte, Index rti, Node *qual);
 static void remove_unused_subquery_outputs(Query *subquery, RelOptInfo *rel);
 
+/** modification start **/
+static DPccpState *dpccp_begin(PlannerInfo *root, int levels_needed,
+							   List *initial_rels);
+static int	dpccp_count_nodes(DPccpState *state, Relids relids);
+static void dpccp_join_search_one_level(DPccpState *state, int level);
+static void card_callback_join_level(PlannerInfo *root, DPccpState *state,
+									 int level);
+static void dpccp_enumerate_csg_rec(DPccpState *state, int level,
+									uint64 subgraph, uint64 excluded,
+									uint64 csg);
+static void dpccp_emit_csg(DPccpState *state, int level, uint64 csg);
+static void dpccp_emit_pair(DPccpState *state, int level,
+							uint64 csg, uint64 cmp);
+static uint64 dpccp_neighborhood(DPccpState *state, uint64 subgraph,
+								 uint64 excluded);
+static bool is_plain_table_rte(RangeTblEntry *rte);
+static void set_plain_rel_size_from_sample(PlannerInfo *root, RelOptInfo *rel,
+										   Selectivity selec,
+										   RelOptInfo *sample_rel);
+static bool is_similar_child_scan(RelOptInfo *template_rel, RelOptInfo *rel);
+static Bitmapset *get_used_indexes_of_rel(RelOptInfo *rel);
+static List *collect_path_indexes(Path *path, List *indexes);
+static Cost greedy_join_cost_bound(PlannerInfo *root, List *initial_rels);
+static RelOptInfo *greedy_join_step(PlannerInfo *root, List **clumps);
+static RelOptInfo *greedy_join_search(PlannerInfo *root, int levels_needed,
+									  List *initial_rels);
+static GreedyJoinTree *build_greedy_join_tree(PlannerInfo *root,
+											  List *initial_rels);
+static RelOptInfo *plan_greedy_join_tree(PlannerInfo *root,
+										 GreedyJoinTree *tree, bool top);
+static bool join_rel_exceeds_cost_bound(PlannerInfo *root, RelOptInfo *rel);
+static void prune_join_rel_level(PlannerInfo *root, int level);
+/** modification end **/
+
 
 /*
  * make_one_rel
@@ -184,6 +272,11 @@ make_one_rel(PlannerInfo *root, List *joinlist)
 	 */
 	set_base_rel_sizes(root);
 
+	/** modification start **/
+	/* With pilotscope.enable_card_callback, ask for the cards of the tables */
+	card_callback_base_rels(root);
+	/** modification end **/
+
 	/*
 	 * We should now have size estimates for every actual table involved in
 	 * the query, and we also know which if any have been deleted from the
@@ -808,6 +901,161 @@ create_plain_partial_paths(PlannerInfo *root, RelOptInfo *rel)
 	add_partial_path(rel, create_seqscan_path(root, rel, NULL, parallel_workers));
 }
 
+/** modification start **/
+/*
+ * is_plain_table_rte
+ *	  Is the RTE scanned by set_plain_rel_size?
+ */
+static bool
+is_plain_table_rte(RangeTblEntry *rte)
+{
+	return rte->rtekind == RTE_RELATION && !rte->inh &&
+		rte->tablesample == NULL &&
+		rte->relkind != RELKIND_FOREIGN_TABLE &&
+		rte->relkind != RELKIND_PARTITIONED_TABLE;
+}
+
+/*
+ * set_plain_rel_size_from_sample
+ *	  Set the size estimates of a plain table child of an append relation
+ *	  from the selectivity of representative siblings, instead of running
+ *	  clauselist_selectivity on its own quals.
+ *
+ * The width comes from the last representative sibling; we leave
+ * attr_widths unset since the attribute numbers of siblings may differ, so
+ * set_append_rel_size falls back on datatype widths for this child.
+ */
+static void
+set_plain_rel_size_from_sample(PlannerInfo *root, RelOptInfo *rel,
+							   Selectivity selec, RelOptInfo *sample_rel)
+{
+	/* Partial unique indexes may still matter, see set_plain_rel_size */
+	check_index_predicates(root, rel);
+
+	rel->rows = clamp_row_est(rel->tuples * selec);
+	cost_qual_eval(&rel->baserestrictcost, rel->baserestrictinfo, root);
+	rel->reltarget->cost = sample_rel->reltarget->cost;
+	rel->reltarget->width = sample_rel->reltarget->width;
+}
+/** modification end **/
+
+/** modification start **/
+/*
+ * is_similar_child_scan
+ *	  Are two plain table children of an append relation alike enough that
+ *	  the indexes useful for one are the ones useful for the other?
+ *
+ * They must have the same indexes, column by column, and sizes within a
+ * factor of two.  Expression indexes are never taken as the same, since
+ * their expressions are written in terms of each child.
+ */
+static bool
+is_similar_child_scan(RelOptInfo *template_rel, RelOptInfo *rel)
+{
+	ListCell   *lc1;
+	ListCell   *lc2;
+
+	if (list_length(rel->indexlist) != list_length(template_rel->indexlist))
+		return false;
+
+	if (rel->rows > template_rel->rows * 2 ||
+		rel->rows * 2 < template_rel->rows ||
+		rel->pages > template_rel->pages * 2 ||
+		rel->pages * 2 < template_rel->pages)
+		return false;
+
+	forboth(lc1, template_rel->indexlist, lc2, rel->indexlist)
+	{
+		IndexOptInfo *index1 = (IndexOptInfo *) lfirst(lc1);
+		IndexOptInfo *index2 = (IndexOptInfo *) lfirst(lc2);
+		int			i;
+
+		if (index1->relam != index2->relam ||
+			index1->ncolumns != index2->ncolumns ||
+			index1->nkeycolumns != index2->nkeycolumns ||
+			index1->unique != index2->unique ||
+			index1->predOK != index2->predOK ||
+			index1->indexprs != NIL || index2->indexprs != NIL)
+			return false;
+
+		for (i = 0; i < index1->ncolumns; i++)
+		{
+			if (index1->indexkeys[i] != index2->indexkeys[i])
+				return false;
+		}
+		for (i = 0; i < index1->nkeycolumns; i++)
+		{
+			if (index1->opfamily[i] != index2->opfamily[i])
+				return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * get_used_indexes_of_rel
+ *	  The positions in rel->indexlist of the indexes used by the surviving
+ *	  paths of the rel, including bitmap and partial paths.
+ */
+static Bitmapset *
+get_used_indexes_of_rel(RelOptInfo *rel)
+{
+	List	   *indexes = NIL;
+	Bitmapset  *result = NULL;
+	ListCell   *lc;
+	int			i = 0;
+
+	foreach(lc, rel->pathlist)
+		indexes = collect_path_indexes((Path *) lfirst(lc), indexes);
+	foreach(lc, rel->partial_pathlist)
+		indexes = collect_path_indexes((Path *) lfirst(lc), indexes);
+
+	foreach(lc, rel->indexlist)
+	{
+		if (list_member_ptr(indexes, lfirst(lc)))
+			result = bms_add_member(result, i);
+		i++;
+	}
+	list_free(indexes);
+
+	return result;
+}
+
+/*
+ * collect_path_indexes
+ *	  Add the indexes scanned by an access path to the given list.
+ */
+static List *
+collect_path_indexes(Path *path, List *indexes)
+{
+	ListCell   *lc;
+
+	switch (nodeTag(path))
+	{
+		case T_IndexPath:
+			indexes = lappend(indexes, ((IndexPath *) path)->indexinfo);
+			break;
+		case T_BitmapHeapPath:
+			indexes = collect_path_indexes(((BitmapHeapPath *) path)->bitmapqual,
+										   indexes);
+			break;
+		case T_BitmapAndPath:
+			foreach(lc, ((BitmapAndPath *) path)->bitmapquals)
+				indexes = collect_path_indexes((Path *) lfirst(lc), indexes);
+			break;
+		case T_BitmapOrPath:
+			foreach(lc, ((BitmapOrPath *) path)->bitmapquals)
+				indexes = collect_path_indexes((Path *) lfirst(lc), indexes);
+			break;
+		default:
+			break;
+	}
+
+	return indexes;
+}
+/** modification end **/
+
 /*
  * set_tablesample_rel_size
  *	  Set size estimates for a sampled relation
@@ -949,6 +1197,13 @@ set_append_rel_size(PlannerInfo *root, RelOptInfo *rel,
 	double	   *parent_attrsizes;
 	int			nattrs;
 	ListCell   *l;
+	/** modification start **/
+	int			sample_stride;
+	int			nchildren_seen;
+	double		sample_rows;
+	double		sample_tuples;
+	RelOptInfo *sample_rel;
+	/** modification end **/
 
 	/* Guard against stack overflow due to overly deep inheritance tree. */
 	check_stack_depth();
@@ -997,6 +1252,35 @@ set_append_rel_size(PlannerInfo *root, RelOptInfo *rel,
 	nattrs = rel->max_attr - rel->min_attr + 1;
 	parent_attrsizes = (double *) palloc0(nattrs * sizeof(double));
 
+	/** modification start **/
+	/*
+	 * With many children, estimate the size of every sample_stride'th child
+	 * only, and derive the size of the other plain table children from the
+	 * selectivity of those.  The per-child card anchors need every child.
+	 */
+	sample_stride = 0;
+	if (partition_sample_size > 0 &&
+		!(subquery_card_fetcher_anchor != NULL &&
+		  subquery_card_fetcher_anchor->enable == 1) &&
+		!(card_replace_anchor != NULL && card_replace_anchor->enable == 1))
+	{
+		int			nchildren = 0;
+
+		foreach(l, root->append_rel_list)
+		{
+			if (((AppendRelInfo *) lfirst(l))->parent_relid == parentRTindex)
+				nchildren++;
+		}
+		if (nchildren > partition_sample_size)
+			sample_stride = (nchildren + partition_sample_size - 1) /
+				partition_sample_size;
+	}
+	nchildren_seen = 0;
+	sample_rows = 0;
+	sample_tuples = 0;
+	sample_rel = NULL;
+	/** modification end **/
+
 	foreach(l, root->append_rel_list)
 	{
 		AppendRelInfo *appinfo = (AppendRelInfo *) lfirst(l);
@@ -1108,7 +1392,25 @@ set_append_rel_size(PlannerInfo *root, RelOptInfo *rel,
 		/*
 		 * Compute the child's size.
 		 */
-		set_rel_size(root, childrel, childRTindex, childRTE);
+		/** modification start **/
+		if (sample_stride > 0 && nchildren_seen++ % sample_stride != 0 &&
+			sample_tuples > 0 && is_plain_table_rte(childRTE))
+			set_plain_rel_size_from_sample(root, childrel,
+										   sample_rows / sample_tuples,
+										   sample_rel);
+		else
+		{
+			set_rel_size(root, childrel, childRTindex, childRTE);
+
+			if (sample_stride > 0 && !IS_DUMMY_REL(childrel) &&
+				is_plain_table_rte(childRTE))
+			{
+				sample_rows += childrel->rows;
+				sample_tuples += childrel->tuples;
+				sample_rel = childrel;
+			}
+		}
+		/** modification end **/
 
 		/*
 		 * It is possible that constraint exclusion detected a contradiction
@@ -1224,6 +1526,10 @@ set_append_rel_pathlist(PlannerInfo *root, RelOptInfo *rel,
 	int			parentRTindex = rti;
 	List	   *live_childrels = NIL;
 	ListCell   *l;
+	/** modification start **/
+	RelOptInfo *template_rel = NULL;
+	Bitmapset  *template_indexes = NULL;
+	/** modification end **/
 
 	/*
 	 * Generate access paths for each member relation, and remember the
@@ -1257,7 +1563,42 @@ set_append_rel_pathlist(PlannerInfo *root, RelOptInfo *rel,
 		/*
 		 * Compute the child's access paths.
 		 */
-		set_rel_pathlist(root, childrel, childRTindex, childRTE);
+		/** modification start **/
+		if (enable_partition_scan_template && template_rel != NULL &&
+			is_plain_table_rte(childRTE) && !IS_DUMMY_REL(childrel) &&
+			is_similar_child_scan(template_rel, childrel))
+		{
+			/*
+			 * Match only the indexes whose counterparts were used by the
+			 * surviving paths of the template child.
+			 */
+			List	   *save_indexlist = childrel->indexlist;
+			List	   *indexlist = NIL;
+			ListCell   *lc;
+			int			i = 0;
+
+			foreach(lc, save_indexlist)
+			{
+				if (bms_is_member(i++, template_indexes))
+					indexlist = lappend(indexlist, lfirst(lc));
+			}
+			childrel->indexlist = indexlist;
+			set_rel_pathlist(root, childrel, childRTindex, childRTE);
+			childrel->indexlist = save_indexlist;
+		}
+		else
+		{
+			set_rel_pathlist(root, childrel, childRTindex, childRTE);
+
+			if (enable_partition_scan_template && template_rel == NULL &&
+				is_plain_table_rte(childRTE) && !IS_DUMMY_REL(childrel) &&
+				childrel->indexlist != NIL)
+			{
+				template_rel = childrel;
+				template_indexes = get_used_indexes_of_rel(childrel);
+			}
+		}
+		/** modification end **/
 
 		/*
 		 * If child is dummy, ignore it.
@@ -3024,7 +3365,13 @@ make_rel_from_joinlist(PlannerInfo *root, List *joinlist)
 		if (join_search_hook)
 			return (*join_search_hook) (root, levels_needed, initial_rels);
 		else if (enable_geqo && levels_needed >= geqo_threshold)
+		/** modification start **/
+		{
+			if (enable_greedy_join_search)
+				return greedy_join_search(root, levels_needed, initial_rels);
 			return geqo(root, levels_needed, initial_rels);
+		}
+		/** modification end **/
 		else
 			return standard_join_search(root, levels_needed, initial_rels);
 	}
@@ -3064,6 +3411,9 @@ standard_join_search(PlannerInfo *root, int levels_needed, List *initial_rels)
 {
 	int			lev;
 	RelOptInfo *rel;
+	/** modification start **/
+	DPccpState *dpccp = NULL;
+	/** modification end **/
 
 	/*
 	 * This function cannot be invoked recursively within any one planning
@@ -3071,6 +3421,26 @@ standard_join_search(PlannerInfo *root, int levels_needed, List *initial_rels)
 	 */
 	Assert(root->join_rel_level == NULL);
 
+	/** modification start **/
+	/*
+	 * In bounded pruning mode, first build a greedy join order; its cost is
+	 * an upper bound for every path worth keeping in the search below.  It
+	 * has to be built before join_rel_level[] exists, so that its join rels
+	 * are not taken for members of the levels.
+	 */
+	join_cost_bound = -1;
+	if (enable_bounded_pruning)
+	{
+		Cost		bound = greedy_join_cost_bound(root, initial_rels);
+
+		if (bound >= 0)
+		{
+			join_cost_bound = bound * bounded_pruning_factor;
+			join_cost_bound_cycle = planning_cycle;
+		}
+	}
+	/** modification end **/
+
 	/*
 	 * We employ a simple "dynamic programming" algorithm: we first find all
 	 * ways to build joins of two jointree items, then all ways to build joins
@@ -3086,6 +3456,16 @@ standard_join_search(PlannerInfo *root, int levels_needed, List *initial_rels)
 
 	root->join_rel_level[1] = initial_rels;
 
+	/** modification start **/
+	/*
+	 * With pilotscope.join_enumerator = dpccp, the pairs of each level come
+	 * from the connected subgraphs of the join graph instead, if the graph
+	 * allows it (see dpccp_begin).
+	 */
+	if (join_enumerator == JOIN_ENUMERATOR_DPCCP)
+		dpccp = dpccp_begin(root, levels_needed, initial_rels);
+	/** modification end **/
+
 	for (lev = 2; lev <= levels_needed; lev++)
 	{
 		ListCell   *lc;
@@ -3095,6 +3475,13 @@ standard_join_search(PlannerInfo *root, int levels_needed, List *initial_rels)
 		 * level, and build paths for making each one from every available
 		 * pair of lower-level relations.
 		 */
+		/** modification start **/
+		if (card_callback_active())
+			card_callback_join_level(root, dpccp, lev);
+		else if (dpccp != NULL)
+			dpccp_join_search_one_level(dpccp, lev);
+		else
+		/** modification end **/
 		join_search_one_level(root, lev);
 
 		/*
@@ -3128,6 +3515,11 @@ standard_join_search(PlannerInfo *root, int levels_needed, List *initial_rels)
 			debug_print_rel(root, rel);
 #endif
 		}
+
+		/** modification start **/
+		if (join_cost_bound >= 0 && lev < levels_needed)
+			prune_join_rel_level(root, lev);
+		/** modification end **/
 	}
 
 	/*
@@ -3141,9 +3533,820 @@ standard_join_search(PlannerInfo *root, int levels_needed, List *initial_rels)
 
 	root->join_rel_level = NULL;
 
+	/** modification start **/
+	if (dpccp != NULL)
+		hash_destroy(dpccp->rels);
+	join_cost_bound = -1;
+	/** modification end **/
+
 	return rel;
 }
 
+/** modification start **/
+/*
+ * greedy_join_cost_bound
+ *	  Build a greedy join order for the initial rels and return the cost of its
+ *	  cheapest path, or -1 if the greedy order gets stuck.
+ *
+ * This is greedy operator ordering: repeatedly join the pair of clumps with
+ * the smallest join size, where the sizes come from set_joinrel_size_estimates
+ * and hence from card_replace_anchor when it has them.  Since every path of
+ * the greedy plan is a real path, its cost is an upper bound of the cost of
+ * the best plan, and (costs growing with the plan) of every join rel in it.
+ *
+ * All join rels built here are thrown away afterwards, the same way as
+ * geqo_eval() does: they live in a temporary memory context, and
+ * join_rel_list and join_rel_hash are restored.  The subqueries that
+ * subquery_card_fetcher_anchor captures while sizing them are copied into
+ * PilotScopeQueryContext by get_subquery_and_card, so they outlive it.
+ */
+static Cost
+greedy_join_cost_bound(PlannerInfo *root, List *initial_rels)
+{
+	MemoryContext mycontext;
+	MemoryContext oldcxt;
+	int			savelength;
+	struct HTAB *savehash;
+	List	   *clumps;
+	Cost		bound = -1;
+
+	mycontext = AllocSetContextCreate(CurrentMemoryContext,
+									  "GreedyJoinBound",
+									  ALLOCSET_DEFAULT_SIZES);
+	oldcxt = MemoryContextSwitchTo(mycontext);
+
+	savelength = list_length(root->join_rel_list);
+	savehash = root->join_rel_hash;
+	root->join_rel_hash = NULL;
+
+	clumps = list_copy(initial_rels);
+	while (list_length(clumps) > 1)
+	{
+		if (greedy_join_step(root, &clumps) == NULL)
+			break;
+	}
+
+	if (list_length(clumps) == 1)
+	{
+		RelOptInfo *final_rel = (RelOptInfo *) linitial(clumps);
+
+		if (final_rel->cheapest_total_path != NULL)
+			bound = final_rel->cheapest_total_path->total_cost;
+	}
+
+	root->join_rel_list = list_truncate(root->join_rel_list, savelength);
+	root->join_rel_hash = savehash;
+	reset_join_rel_mask_table(root);
+
+	MemoryContextSwitchTo(oldcxt);
+	MemoryContextDelete(mycontext);
+
+	return bound;
+}
+
+/*
+ * greedy_join_step
+ *	  Join the two clumps with the smallest join size and replace them by
+ *	  their join rel in *clumps.  Returns the join rel, or NULL if no two
+ *	  clumps can be joined.
+ *
+ * Pairs linked by a join clause or a join order restriction are preferred;
+ * only if there is none we look at clauseless joins.  The candidates are
+ * sized without paths, only the chosen pair gets them.
+ */
+static RelOptInfo *
+greedy_join_step(PlannerInfo *root, List **clumps)
+{
+	RelOptInfo *best_rel1 = NULL;
+	RelOptInfo *best_rel2 = NULL;
+	double		best_rows = 0;
+	RelOptInfo *joinrel;
+	int			clauseless;
+
+	for (clauseless = 0; clauseless <= 1 && best_rel1 == NULL; clauseless++)
+	{
+		ListCell   *lc1;
+
+		foreach(lc1, *clumps)
+		{
+			RelOptInfo *rel1 = (RelOptInfo *) lfirst(lc1);
+			ListCell   *lc2;
+
+			for_each_cell(lc2, *clumps, lnext(*clumps, lc1))
+			{
+				RelOptInfo *rel2 = (RelOptInfo *) lfirst(lc2);
+				RelOptInfo *candidate;
+
+				if (!clauseless &&
+					!have_relevant_joinclause(root, rel1, rel2) &&
+					!have_join_order_restriction(root, rel1, rel2))
+					continue;
+
+				candidate = make_join_rel_without_paths(root, rel1, rel2);
+				if (candidate == NULL)
+					continue;
+
+				if (best_rel1 == NULL || candidate->rows < best_rows)
+				{
+					best_rel1 = rel1;
+					best_rel2 = rel2;
+					best_rows = candidate->rows;
+				}
+			}
+		}
+	}
+
+	if (best_rel1 == NULL)
+		return NULL;
+
+	joinrel = make_join_rel(root, best_rel1, best_rel2);
+	if (joinrel == NULL || joinrel->pathlist == NIL)
+		return NULL;
+
+	/* Nothing will add paths to it any more, so we can pick the cheapest */
+	set_cheapest(joinrel);
+
+	*clumps = list_delete_ptr(*clumps, best_rel1);
+	*clumps = list_delete_ptr(*clumps, best_rel2);
+	*clumps = lappend(*clumps, joinrel);
+
+	return joinrel;
+}
+
+/*
+ * greedy_join_search
+ *	  Find a join order for a join problem too large for the standard search,
+ *	  replacing GEQO when pilotscope.enable_greedy_join_search is on.
+ *
+ * We first build a join tree by greedy operator ordering, whose choices
+ * follow the join sizes and hence the cardinalities of card_replace_anchor
+ * when it has them (see greedy_join_step), and then improve it window by
+ * window with exhaustive dynamic programming (see plan_greedy_join_tree).
+ * If the greedy ordering gets stuck we fall back to GEQO.
+ */
+static RelOptInfo *
+greedy_join_search(PlannerInfo *root, int levels_needed, List *initial_rels)
+{
+	GreedyJoinTree *tree;
+
+	tree = build_greedy_join_tree(root, initial_rels);
+	if (tree == NULL)
+		return geqo(root, levels_needed, initial_rels);
+
+	return plan_greedy_join_tree(root, tree, true);
+}
+
+/*
+ * build_greedy_join_tree
+ *	  Join the initial rels by greedy operator ordering and return the shape
+ *	  of the resulting join tree, or NULL if the greedy ordering gets stuck.
+ *
+ * As in greedy_join_cost_bound, the join rels built on the way are thrown
+ * away again; only the tree, allocated in the caller's context, survives.
+ */
+static GreedyJoinTree *
+build_greedy_join_tree(PlannerInfo *root, List *initial_rels)
+{
+	MemoryContext outercxt = CurrentMemoryContext;
+	MemoryContext mycontext;
+	int			savelength;
+	struct HTAB *savehash;
+	List	   *clumps;
+	List	   *trees = NIL;
+	GreedyJoinTree *result = NULL;
+	ListCell   *lc;
+
+	mycontext = AllocSetContextCreate(CurrentMemoryContext,
+									  "GreedyJoinOrder",
+									  ALLOCSET_DEFAULT_SIZES);
+	MemoryContextSwitchTo(mycontext);
+
+	savelength = list_length(root->join_rel_list);
+	savehash = root->join_rel_hash;
+	root->join_rel_hash = NULL;
+
+	/* The trees of the clumps, in no particular order */
+	foreach(lc, initial_rels)
+	{
+		RelOptInfo *rel = (RelOptInfo *) lfirst(lc);
+		GreedyJoinTree *leaf;
+
+		leaf = MemoryContextAllocZero(outercxt, sizeof(GreedyJoinTree));
+		leaf->relids = rel->relids;
+		leaf->nleaves = 1;
+		leaf->rel = rel;
+		trees = lappend(trees, leaf);
+	}
+
+	clumps = list_copy(initial_rels);
+	while (list_length(clumps) > 1)
+	{
+		RelOptInfo *joinrel = greedy_join_step(root, &clumps);
+		GreedyJoinTree *node;
+
+		if (joinrel == NULL)
+			break;
+
+		/* The two clumps joined are the ones within the new join rel */
+		node = MemoryContextAllocZero(outercxt, sizeof(GreedyJoinTree));
+		foreach(lc, trees)
+		{
+			GreedyJoinTree *tree = (GreedyJoinTree *) lfirst(lc);
+
+			if (!bms_is_subset(tree->relids, joinrel->relids))
+				continue;
+			if (node->left == NULL)
+				node->left = tree;
+			else
+				node->right = tree;
+			trees = foreach_delete_current(trees, lc);
+		}
+		Assert(node->left != NULL && node->right != NULL);
+
+		MemoryContextSwitchTo(outercxt);
+		node->relids = bms_union(node->left->relids, node->right->relids);
+		MemoryContextSwitchTo(mycontext);
+		node->nleaves = node->left->nleaves + node->right->nleaves;
+		trees = lappend(trees, node);
+	}
+
+	if (list_length(clumps) == 1)
+		result = (GreedyJoinTree *) linitial(trees);
+
+	root->join_rel_list = list_truncate(root->join_rel_list, savelength);
+	root->join_rel_hash = savehash;
+	reset_join_rel_mask_table(root);
+
+	MemoryContextSwitchTo(outercxt);
+	MemoryContextDelete(mycontext);
+
+	return result;
+}
+
+/*
+ * plan_greedy_join_tree
+ *	  Build the join rel of a greedy join tree node with its paths.
+ *
+ * The node is expanded into a window of at most pilotscope.greedy_join_window
+ * subtrees by repeatedly splitting its largest subtree.  The subtrees are
+ * planned recursively, each being a window of its own, and then joined in
+ * the best order by dynamic programming over all subsets of the window.
+ * The greedy order is among those, so this can't fail where it didn't.
+ *
+ * 'top' is true for the root of the tree, whose gather paths are left to
+ * grouping_planner as in standard_join_search.
+ */
+static RelOptInfo *
+plan_greedy_join_tree(PlannerInfo *root, GreedyJoinTree *tree, bool top)
+{
+	GreedyJoinTree *units[GREEDY_JOIN_MAX_WINDOW];
+	int			window = Min(greedy_join_window, GREEDY_JOIN_MAX_WINDOW);
+	int			nunits;
+	int			full;
+	int			mask;
+	int			i;
+	RelOptInfo **rels;
+	RelOptInfo *result;
+
+	if (tree->rel != NULL)
+		return tree->rel;
+
+	units[0] = tree->left;
+	units[1] = tree->right;
+	nunits = 2;
+	while (nunits < window)
+	{
+		int			largest = -1;
+
+		for (i = 0; i < nunits; i++)
+		{
+			if (units[i]->nleaves > 1 &&
+				(largest < 0 || units[i]->nleaves > units[largest]->nleaves))
+				largest = i;
+		}
+		if (largest < 0)
+			break;
+
+		units[nunits++] = units[largest]->right;
+		units[largest] = units[largest]->left;
+	}
+
+	/* rels[mask] is the join rel of the units in mask */
+	full = (1 << nunits) - 1;
+	rels = (RelOptInfo **) palloc0((full + 1) * sizeof(RelOptInfo *));
+	for (i = 0; i < nunits; i++)
+		rels[1 << i] = plan_greedy_join_tree(root, units[i], false);
+
+	/* Subsets come before their supersets in numerical order */
+	for (mask = 1; mask <= full; mask++)
+	{
+		RelOptInfo *rel;
+		int			clauseless;
+
+		if ((mask & (mask - 1)) == 0)
+			continue;			/* a single unit */
+
+		/* As in greedy_join_step, try clauseless joins only as a last resort */
+		for (clauseless = 0; clauseless <= 1 && rels[mask] == NULL; clauseless++)
+		{
+			int			sub;
+
+			for (sub = (mask - 1) & mask; sub > 0; sub = (sub - 1) & mask)
+			{
+				int			other = mask & ~sub;
+				RelOptInfo *joinrel;
+
+				/* Visit each pair once; make_join_rel tries both sides */
+				if (sub < other || rels[sub] == NULL || rels[other] == NULL)
+					continue;
+
+				if (!clauseless &&
+					!have_relevant_joinclause(root, rels[sub], rels[other]) &&
+					!have_join_order_restriction(root, rels[sub], rels[other]))
+					continue;
+
+				joinrel = make_join_rel(root, rels[sub], rels[other]);
+				if (joinrel != NULL)
+					rels[mask] = joinrel;
+			}
+		}
+
+		rel = rels[mask];
+		if (rel == NULL)
+			continue;
+
+		/* Finish the rel, as standard_join_search does for each level */
+		generate_partitionwise_join_paths(root, rel);
+		if (!(top && mask == full))
+			generate_useful_gather_paths(root, rel, false);
+		set_cheapest(rel);
+	}
+
+	result = rels[full];
+	if (result == NULL)
+		elog(ERROR, "failed to build any %d-way joins", tree->nleaves);
+
+	pfree(rels);
+
+	return result;
+}
+
+/*
+ * join_cost_exceeds_bound
+ *	  Check whether a path of the given rel with the given total cost may be
+ *	  dropped because it costs more than the bound of the join search in
+ *	  progress.
+ *
+ * Only unsorted, unparameterized paths of the join rels of the search itself
+ * are pruned, and only if the rel is not interested in startup cost: a path
+ * with a higher total cost may still win below a LIMIT.  The bound is the
+ * cost of the greedy plan without the sorts it may need on top, so a sorted
+ * path costing more may still win by saving them.
+ */
+bool
+join_cost_exceeds_bound(RelOptInfo *rel, Cost total_cost,
+						List *pathkeys, Relids required_outer)
+{
+	if (join_cost_bound < 0 || join_cost_bound_cycle != planning_cycle)
+		return false;
+
+	if (rel->reloptkind != RELOPT_JOINREL || rel->consider_startup ||
+		pathkeys != NIL || required_outer != NULL)
+		return false;
+
+	return total_cost > join_cost_bound;
+}
+
+/*
+ * join_rel_exceeds_cost_bound
+ *	  Check whether even the cheapest path of a finished join rel costs more
+ *	  than the bound of the join search in progress.
+ *
+ * A rel with useful pathkeys is kept, since its sorted paths may save sorts
+ * of the levels above that the bound doesn't account for.
+ */
+static bool
+join_rel_exceeds_cost_bound(PlannerInfo *root, RelOptInfo *rel)
+{
+	if (rel->cheapest_total_path == NULL || has_useful_pathkeys(root, rel))
+		return false;
+
+	return join_cost_exceeds_bound(rel, rel->cheapest_total_path->total_cost,
+								   NIL, NULL);
+}
+
+/*
+ * prune_join_rel_level
+ *	  Drop the join rels of a finished level whose cheapest path costs more
+ *	  than the bound, so that the levels above don't build on them.
+ *
+ * The join rels of the greedy plan are never above the bound, so normally a
+ * complete plan survives; if a level would become empty anyway (e.g. the
+ * estimates moved between the greedy plan and the search) we keep it as is.
+ */
+static void
+prune_join_rel_level(PlannerInfo *root, int level)
+{
+	List	   *kept = NIL;
+	ListCell   *lc;
+
+	foreach(lc, root->join_rel_level[level])
+	{
+		RelOptInfo *rel = (RelOptInfo *) lfirst(lc);
+
+		if (!join_rel_exceeds_cost_bound(root, rel))
+			kept = lappend(kept, rel);
+	}
+
+	if (kept != NIL)
+		root->join_rel_level[level] = kept;
+}
+/** modification end **/
+
+/** modification start **/
+/*
+ * dpccp_begin
+ *	  Set up the DPccp enumeration for a join search, or return NULL if the
+ *	  join graph doesn't allow it.
+ *
+ * DPccp (Moerkotte and Neumann) only generates pairs of disjoint connected
+ * subgraphs with an edge between them, where join_search_one_level tests every
+ * pair of lower-level rels.  On sparse graphs such as stars and snowflakes that
+ * cuts the number of pair tests and make_join_rel calls by orders of magnitude,
+ * while producing the same join rels and the same joins as the standard search.
+ *
+ * That equivalence needs the join graph to describe every legal join, so we
+ * only use DPccp for plain inner-join problems of at most 64 items whose join
+ * graph is connected and whose join clauses and equivalence members each link
+ * at most two items.  Anything else (special joins, lateral references,
+ * clauseless joins, hyperedges) is left to join_search_one_level.  Legality is
+ * still checked by make_join_rel through join_is_legal.
+ */
+static DPccpState *
+dpccp_begin(PlannerInfo *root, int levels_needed, List *initial_rels)
+{
+	DPccpState *state;
+	HASHCTL		hash_ctl;
+	ListCell   *lc;
+	uint64		reached;
+	uint64		frontier;
+	int			i,
+				j;
+
+	if (levels_needed > 64 ||
+		root->join_info_list != NIL ||
+		root->hasLateralRTEs)
+		return NULL;
+
+	state = (DPccpState *) palloc0(sizeof(DPccpState));
+	state->root = root;
+	state->nnodes = levels_needed;
+	state->nodes = (RelOptInfo **) palloc(levels_needed * sizeof(RelOptInfo *));
+	state->adj = (uint64 *) palloc0(levels_needed * sizeof(uint64));
+
+	i = 0;
+	foreach(lc, initial_rels)
+		state->nodes[i++] = (RelOptInfo *) lfirst(lc);
+
+	/* No join clause may link more than two nodes ... */
+	for (i = 0; i < state->nnodes; i++)
+	{
+		foreach(lc, state->nodes[i]->joininfo)
+		{
+			RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+
+			if (dpccp_count_nodes(state, rinfo->required_relids) > 2)
+				return NULL;
+		}
+	}
+
+	/* ... and no equivalence member may span more than one node */
+	foreach(lc, root->eq_classes)
+	{
+		EquivalenceClass *ec = (EquivalenceClass *) lfirst(lc);
+		ListCell   *lc2;
+
+		foreach(lc2, ec->ec_members)
+		{
+			EquivalenceMember *em = (EquivalenceMember *) lfirst(lc2);
+
+			if (!em->em_is_child &&
+				dpccp_count_nodes(state, em->em_relids) > 1)
+				return NULL;
+		}
+	}
+
+	/* Build the edges */
+	for (i = 0; i < state->nnodes; i++)
+	{
+		for (j = i + 1; j < state->nnodes; j++)
+		{
+			if (have_relevant_joinclause(root, state->nodes[i], state->nodes[j]))
+			{
+				state->adj[i] |= UINT64CONST(1) << j;
+				state->adj[j] |= UINT64CONST(1) << i;
+			}
+		}
+	}
+
+	/* The graph must be connected, or we'd need clauseless joins */
+	reached = UINT64CONST(1);
+	frontier = reached;
+	while (frontier != 0)
+	{
+		frontier = dpccp_neighborhood(state, reached, 0);
+		reached |= frontier;
+	}
+	if (pg_popcount64(reached) != state->nnodes)
+		return NULL;
+
+	MemSet(&hash_ctl, 0, sizeof(hash_ctl));
+	hash_ctl.keysize = sizeof(uint64);
+	hash_ctl.entrysize = sizeof(DPccpRel);
+	hash_ctl.hcxt = CurrentMemoryContext;
+	state->rels = hash_create("DPccp join rels",
+							  256L,
+							  &hash_ctl,
+							  HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	return state;
+}
+
+/*
+ * dpccp_count_nodes
+ *	  Count the nodes whose relids overlap the given relids.  Relids that
+ *	  belong to no node don't count; such clauses can't be used in this search.
+ */
+static int
+dpccp_count_nodes(DPccpState *state, Relids relids)
+{
+	int			count = 0;
+	int			i;
+
+	for (i = 0; i < state->nnodes; i++)
+	{
+		if (bms_overlap(state->nodes[i]->relids, relids))
+			count++;
+	}
+
+	return count;
+}
+
+/*
+ * dpccp_join_search_one_level
+ *	  Build the join rels of one level from the csg-cmp pairs of that size.
+ *
+ * The pairs are enumerated again for every level, with the recursion cut off
+ * at the level's size, so that the join rels of a level are complete (and
+ * set_cheapest has been run on them) before the next level uses them, as in
+ * standard_join_search.  The enumeration itself is pure bitmask work.
+ */
+static void
+dpccp_join_search_one_level(DPccpState *state, int level)
+{
+	int			i;
+
+	/* Set join_cur_level so that new joinrels are added to proper list */
+	state->root->join_cur_level = level;
+
+	/*
+	 * EnumerateCsg: each node in descending order starts the connected
+	 * subgraphs whose smallest node it is.
+	 */
+	for (i = state->nnodes - 1; i >= 0; i--)
+	{
+		uint64		node = UINT64CONST(1) << i;
+
+		dpccp_emit_csg(state, level, node);
+		dpccp_enumerate_csg_rec(state, level, node,
+								(node << 1) - 1, 0);
+	}
+}
+
+/*
+ * card_callback_join_level
+ *	  Search one level of the join search, after building its join rels with
+ *	  their size estimates but no paths and asking the python side for their
+ *	  cards in one request.
+ *
+ * The sizing pass enumerates the level exactly as the search does, so that
+ * each join rel is built from the same pair of input rels and gets the same
+ * subquery.  Its rels are then taken out of join_rel_level[] again, and
+ * make_join_rel puts them back when the search makes them; so the search
+ * sees an empty level to begin with, and builds the last-ditch clauseless
+ * joins of join_search_one_level itself if the sizing pass had to.  All the
+ * paths are then costed with the final rows.
+ */
+static void
+card_callback_join_level(PlannerInfo *root, DPccpState *state, int level)
+{
+	PlannerInfo *save_sizing_root = join_rels_sizing_root;
+	PlannerInfo *save_sized_root = sized_join_rels_root;
+	struct HTAB *save_sized_rels = sized_join_rels;
+	HTAB	   *sized_rels = NULL;
+
+	PG_TRY();
+	{
+		if (card_callback_begin(root))
+		{
+			HASHCTL		hash_ctl;
+			ListCell   *lc;
+
+			join_rels_sizing_root = root;
+			if (state != NULL)
+				dpccp_join_search_one_level(state, level);
+			else
+				join_search_one_level(root, level);
+			join_rels_sizing_root = save_sizing_root;
+
+			card_callback_end(root);
+
+			MemSet(&hash_ctl, 0, sizeof(hash_ctl));
+			hash_ctl.keysize = sizeof(RelOptInfo *);
+			hash_ctl.entrysize = sizeof(RelOptInfo *);
+			hash_ctl.hcxt = CurrentMemoryContext;
+			sized_rels = hash_create("Sized join rels",
+									 Max(list_length(root->join_rel_level[level]), 16),
+									 &hash_ctl,
+									 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+			foreach(lc, root->join_rel_level[level])
+			{
+				RelOptInfo *joinrel = (RelOptInfo *) lfirst(lc);
+
+				hash_search(sized_rels, &joinrel, HASH_ENTER, NULL);
+			}
+			list_free(root->join_rel_level[level]);
+			root->join_rel_level[level] = NIL;
+
+			sized_join_rels_root = root;
+			sized_join_rels = sized_rels;
+		}
+
+		if (state != NULL)
+			dpccp_join_search_one_level(state, level);
+		else
+			join_search_one_level(root, level);
+	}
+	PG_FINALLY();
+	{
+		join_rels_sizing_root = save_sizing_root;
+		sized_join_rels_root = save_sized_root;
+		sized_join_rels = save_sized_rels;
+	}
+	PG_END_TRY();
+
+	if (sized_rels != NULL)
+		hash_destroy(sized_rels);
+}
+
+/*
+ * dpccp_enumerate_csg_rec
+ *	  EnumerateCsgRec: extend the connected subgraph by subsets of its
+ *	  neighborhood that avoid the excluded nodes.
+ *
+ * With csg == 0 the subgraphs are csgs of their own and handed to
+ * dpccp_emit_csg; otherwise they are complements of csg, and the pairs are
+ * handed to dpccp_emit_pair.  Subgraphs larger than the level allows are not
+ * built.
+ */
+static void
+dpccp_enumerate_csg_rec(DPccpState *state, int level, uint64 subgraph,
+						uint64 excluded, uint64 csg)
+{
+	uint64		neighbors = dpccp_neighborhood(state, subgraph, excluded);
+	int			maxsize;
+	uint64		subset;
+
+	if (neighbors == 0)
+		return;
+
+	maxsize = (csg == 0) ? level - 1 : level - pg_popcount64(csg);
+
+	for (subset = neighbors; subset != 0; subset = (subset - 1) & neighbors)
+	{
+		uint64		grown = subgraph | subset;
+
+		if (pg_popcount64(grown) > maxsize)
+			continue;
+		if (csg == 0)
+			dpccp_emit_csg(state, level, grown);
+		else
+			dpccp_emit_pair(state, level, csg, grown);
+	}
+
+	for (subset = neighbors; subset != 0; subset = (subset - 1) & neighbors)
+	{
+		uint64		grown = subgraph | subset;
+
+		if (pg_popcount64(grown) < maxsize)
+			dpccp_enumerate_csg_rec(state, level, grown,
+									excluded | neighbors, csg);
+	}
+}
+
+/*
+ * dpccp_emit_csg
+ *	  EnumerateCmp: find the complements of one connected subgraph.
+ *
+ * Complements only use neighbors that are larger than the smallest node of
+ * the csg, so that every pair is produced exactly once.
+ */
+static void
+dpccp_emit_csg(DPccpState *state, int level, uint64 csg)
+{
+	uint64		lowest = csg & (~csg + 1);
+	uint64		excluded = ((lowest << 1) - 1) | csg;
+	uint64		neighbors;
+	int			i;
+
+	if (pg_popcount64(csg) >= level)
+		return;
+
+	neighbors = dpccp_neighborhood(state, csg, excluded);
+	for (i = state->nnodes - 1; i >= 0; i--)
+	{
+		uint64		node = UINT64CONST(1) << i;
+
+		if ((neighbors & node) == 0)
+			continue;
+
+		dpccp_emit_pair(state, level, csg, node);
+		dpccp_enumerate_csg_rec(state, level, node,
+								excluded | (neighbors & ((node << 1) - 1)),
+								csg);
+	}
+}
+
+/*
+ * dpccp_emit_pair
+ *	  Build the join of a csg-cmp pair if it belongs to this level.
+ */
+static void
+dpccp_emit_pair(DPccpState *state, int level, uint64 csg, uint64 cmp)
+{
+	RelOptInfo *rels[2];
+	uint64		sides[2];
+	RelOptInfo *joinrel;
+	DPccpRel   *entry;
+	uint64		joinnodes = csg | cmp;
+	bool		found;
+	int			i;
+
+	if (pg_popcount64(joinnodes) != level)
+		return;
+
+	sides[0] = csg;
+	sides[1] = cmp;
+	for (i = 0; i < 2; i++)
+	{
+		if (pg_popcount64(sides[i]) == 1)
+			rels[i] = state->nodes[pg_rightmost_one_pos64(sides[i])];
+		else
+		{
+			entry = (DPccpRel *) hash_search(state->rels, &sides[i],
+											 HASH_FIND, NULL);
+			if (entry == NULL || entry->rel == NULL)
+				return;			/* no legal way to build that side */
+			if (join_cost_bound >= 0 &&
+				!list_member_ptr(state->root->join_rel_level[pg_popcount64(sides[i])],
+								 entry->rel))
+				return;			/* pruned by prune_join_rel_level */
+			rels[i] = entry->rel;
+		}
+	}
+
+	joinrel = make_join_rel(state->root, rels[0], rels[1]);
+
+	/* Remember the join rel for the levels above, even if this pair failed */
+	entry = (DPccpRel *) hash_search(state->rels, &joinnodes,
+									 HASH_ENTER, &found);
+	if (!found || joinrel != NULL)
+		entry->rel = joinrel;
+}
+
+/*
+ * dpccp_neighborhood
+ *	  The nodes adjacent to a subgraph, less the subgraph and the excluded
+ *	  nodes.
+ */
+static uint64
+dpccp_neighborhood(DPccpState *state, uint64 subgraph, uint64 excluded)
+{
+	uint64		neighbors = 0;
+	uint64		rest = subgraph;
+
+	while (rest != 0)
+	{
+		int			i = pg_rightmost_one_pos64(rest);
+
+		neighbors |= state->adj[i];
+		rest &= rest - 1;
+	}
+
+	return neighbors & ~(subgraph | excluded);
+}
+/** modification end **/
+
 /*****************************************************************************
  *			PUSHING QUALS DOWN INTO SUBQUERIES
  *****************************************************************************/
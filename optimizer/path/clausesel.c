@@ -26,6 +26,55 @@
 #include "utils/lsyscache.h"
 #include "utils/selfuncs.h"
 
+/** modification start **/
+#include "access/htup_details.h"
+#include "catalog/pg_statistic.h"
+#include "utils/array.h"
+#include "utils/hsearch.h"
+#include "utils/sortsupport.h"
+#include "utils/typcache.h"
+#include "utils/subplanquery.h"
+#include "utils/utils.h"
+#include "anchor2struct.h"
+#include "time.h"
+
+/*
+ * Per-planning memo of clause_selectivity results for clauses that can't cache
+ * their selectivity in a RestrictInfo, i.e. bare expressions and clauses estimated
+ * with a varRelid other than their own relation. Only estimates without a
+ * SpecialJoinInfo are remembered, since those depend on nothing but the key.
+ */
+typedef struct ClauseSelectivityMemoKey
+{
+	PlannerInfo *root;
+	Node	   *clause;			/* the clause as passed to clause_selectivity */
+	int			varRelid;
+	JoinType	jointype;
+} ClauseSelectivityMemoKey;
+
+typedef struct ClauseSelectivityMemoEntry
+{
+	ClauseSelectivityMemoKey key;	/* hash key --- MUST BE FIRST */
+	Selectivity selec;
+} ClauseSelectivityMemoEntry;
+
+static HTAB *clause_selectivity_memo = NULL;
+static int	clause_selectivity_memo_cycle = 0;
+
+/*
+ * "var = ANY (const array)" clauses with at least this many elements are
+ * estimated by batched_scalararraysel instead of scalararraysel.
+ */
+#define BATCHED_SAOP_MIN_ELEMENTS 100
+
+/* A value to be merged in batched_scalararraysel, and where it came from */
+typedef struct SortedDatum
+{
+	Datum		value;
+	int			index;
+} SortedDatum;
+/** modification end **/
+
 /*
  * Data structure for accumulating info about possible range-query
  * clause pairs in clauselist_selectivity.
@@ -45,6 +94,16 @@ static void addRangeClause(RangeQueryClause **rqlist, Node *clause,
 static RelOptInfo *find_single_rel_for_clauses(PlannerInfo *root,
 											   List *clauses);
 
+/** modification start **/
+static HTAB *get_clause_selectivity_memo(PlannerInfo *root);
+static bool is_fingerprintable_clause(Node *clause);
+static bool get_injected_selectivity(PlannerInfo *root, List *clauses,
+									 int varRelid, Selectivity *selec);
+static bool batched_scalararraysel(PlannerInfo *root, ScalarArrayOpExpr *clause,
+								   int varRelid, Selectivity *selec);
+static int	sorted_datum_cmp(const void *a, const void *b, void *arg);
+/** modification end **/
+
 /****************************************************************************
  *		ROUTINES TO COMPUTE SELECTIVITIES
  ****************************************************************************/
@@ -76,6 +135,16 @@ clauselist_selectivity(PlannerInfo *root,
 	RelOptInfo *rel;
 	Bitmapset  *estimatedclauses = NULL;
 
+	/** modification start **/
+	/*
+	 * Use the selectivity of selectivity_replace_anchor if the whole clause set
+	 * is known to it.  Single clauses are looked up by clause_selectivity.
+	 */
+	if (list_length(clauses) > 1 &&
+		get_injected_selectivity(root, clauses, varRelid, &s1))
+		return s1;
+	/** modification end **/
+
 	/*
 	 * Determine if these clauses reference a single relation.  If so, and if
 	 * it has extended statistics, try to apply those.
@@ -606,6 +675,11 @@ clause_selectivity(PlannerInfo *root,
 	Selectivity s1 = 0.5;		/* default for any unhandled clause type */
 	RestrictInfo *rinfo = NULL;
 	bool		cacheable = false;
+	/** modification start **/
+	Node	   *memo_clause = clause;
+	HTAB	   *memo = NULL;
+	bool		injected;
+	/** modification end **/
 
 	if (clause == NULL)			/* can this still happen? */
 		return s1;
@@ -673,6 +747,43 @@ clause_selectivity(PlannerInfo *root,
 			clause = (Node *) rinfo->clause;
 	}
 
+	/** modification start **/
+	/*
+	 * Clauses that can't be cached above are served from the per-planning memo,
+	 * since path costing asks for the same selectivities many times over.
+	 */
+	if (sjinfo == NULL && !cacheable)
+	{
+		ClauseSelectivityMemoKey key;
+		ClauseSelectivityMemoEntry *entry;
+
+		memo = get_clause_selectivity_memo(root);
+		if (memo != NULL)
+		{
+			MemSet(&key, 0, sizeof(key));
+			key.root = root;
+			key.clause = memo_clause;
+			key.varRelid = varRelid;
+			key.jointype = jointype;
+			entry = (ClauseSelectivityMemoEntry *) hash_search(memo, &key,
+															   HASH_FIND, NULL);
+			if (entry != NULL)
+				return entry->selec;
+		}
+	}
+
+	// set selectivity of the clause if it exists in selectivity_replace_anchor
+	injected = (selectivity_replace_anchor != NULL &&
+				selectivity_replace_anchor->enable == 1 &&
+				get_injected_selectivity(root, list_make1(memo_clause),
+										 varRelid, &s1));
+
+	if (injected)
+	{
+		/* s1 has been set by selectivity_replace_anchor */
+	}
+	else
+	/** modification end **/
 	if (IsA(clause, Var))
 	{
 		Var		   *var = (Var *) clause;
@@ -803,14 +914,24 @@ clause_selectivity(PlannerInfo *root,
 	}
 	else if (IsA(clause, ScalarArrayOpExpr))
 	{
-		/* Use node specific selectivity calculation function */
-		s1 = scalararraysel(root,
-							(ScalarArrayOpExpr *) clause,
-							treat_as_join_clause(clause, rinfo,
-												 varRelid, sjinfo),
-							varRelid,
-							jointype,
-							sjinfo);
+		/** modification start **/
+		bool		is_join_clause = treat_as_join_clause(clause, rinfo,
+														  varRelid, sjinfo);
+
+		/* Large IN lists are estimated in one pass, see below */
+		if (is_join_clause ||
+			!batched_scalararraysel(root, (ScalarArrayOpExpr *) clause,
+									varRelid, &s1))
+		{
+			/* Use node specific selectivity calculation function */
+			s1 = scalararraysel(root,
+								(ScalarArrayOpExpr *) clause,
+								is_join_clause,
+								varRelid,
+								jointype,
+								sjinfo);
+		}
+		/** modification end **/
 	}
 	else if (IsA(clause, RowCompareExpr))
 	{
@@ -889,9 +1010,391 @@ clause_selectivity(PlannerInfo *root,
 			rinfo->outer_selec = s1;
 	}
 
+	/** modification start **/
+	/* Remember it in the per-planning memo if we looked there */
+	if (memo != NULL)
+	{
+		ClauseSelectivityMemoKey key;
+		ClauseSelectivityMemoEntry *entry;
+
+		MemSet(&key, 0, sizeof(key));
+		key.root = root;
+		key.clause = memo_clause;
+		key.varRelid = varRelid;
+		key.jointype = jointype;
+		entry = (ClauseSelectivityMemoEntry *) hash_search(memo, &key,
+														   HASH_ENTER, NULL);
+		entry->selec = s1;
+	}
+	/** modification end **/
+
 #ifdef SELECTIVITY_DEBUG
 	elog(DEBUG4, "clause_selectivity: s1 %f", s1);
 #endif							/* SELECTIVITY_DEBUG */
 
 	return s1;
 }
+
+/** modification start **/
+/*
+ * get_clause_selectivity_memo
+ *	  Get the per-planning memo of clause_selectivity, building a new one if the
+ *	  current one belongs to an earlier planning cycle.
+ *
+ * Returns NULL while we are not working in the planner's own memory context:
+ * GEQO recycles the memory of its temporary contexts, so the addresses of the
+ * clauses built there can't be trusted as keys.
+ */
+static HTAB *
+get_clause_selectivity_memo(PlannerInfo *root)
+{
+	HASHCTL		hash_ctl;
+
+	if (CurrentMemoryContext != root->planner_cxt)
+		return NULL;
+
+	if (clause_selectivity_memo != NULL &&
+		clause_selectivity_memo_cycle == planning_cycle)
+		return clause_selectivity_memo;
+
+	MemSet(&hash_ctl, 0, sizeof(hash_ctl));
+	hash_ctl.keysize = sizeof(ClauseSelectivityMemoKey);
+	hash_ctl.entrysize = sizeof(ClauseSelectivityMemoEntry);
+	hash_ctl.hcxt = root->planner_cxt;
+	clause_selectivity_memo = hash_create("ClauseSelectivityMemo",
+										  256L,
+										  &hash_ctl,
+										  HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	clause_selectivity_memo_cycle = planning_cycle;
+
+	return clause_selectivity_memo;
+}
+
+/*
+ * is_fingerprintable_clause
+ *	  Check whether get_expr can write the whole clause into a fingerprint.
+ *
+ * Anything else would leave a hole in the fingerprint and could make two
+ * different clause sets look the same.
+ */
+static bool
+is_fingerprintable_clause(Node *clause)
+{
+	ListCell   *l;
+
+	if (clause == NULL)
+		return false;
+
+	if (IsA(clause, RestrictInfo))
+		clause = (Node *) ((RestrictInfo *) clause)->clause;
+
+	if (IsA(clause, Var))
+		return ((Var *) clause)->varlevelsup == 0;
+	if (IsA(clause, Const))
+		return !((Const *) clause)->constisnull;
+	if (IsA(clause, OpExpr))
+	{
+		foreach(l, ((OpExpr *) clause)->args)
+		{
+			if (!is_fingerprintable_clause((Node *) lfirst(l)))
+				return false;
+		}
+		return true;
+	}
+	return false;
+}
+
+/*
+ * get_injected_selectivity
+ *	  Look up the selectivity of a clause set in selectivity_replace_anchor.
+ *
+ * The clause set is fingerprinted as a count(*) subquery over the relations it
+ * refers to (only varRelid, if that's given) and the clauses themselves. Returns
+ * false if there is no such anchor, the clause set can't be fingerprinted or the
+ * fingerprint is unknown.
+ */
+static bool
+get_injected_selectivity(PlannerInfo *root, List *clauses, int varRelid,
+						 Selectivity *selec)
+{
+	Relids		relids = NULL;
+	char	   *new_selec = NULL;
+	ListCell   *l;
+	int			relid;
+	clock_t		starttime;
+
+	if (selectivity_replace_anchor == NULL ||
+		selectivity_replace_anchor->enable != 1 ||
+		clauses == NIL)
+		return false;
+
+	// start time
+	starttime = start_to_record_time();
+
+	foreach(l, clauses)
+	{
+		Node	   *clause = (Node *) lfirst(l);
+
+		if (!is_fingerprintable_clause(clause))
+		{
+			bms_free(relids);
+			selectivityreplace_time += end_time(starttime);
+			return false;
+		}
+
+		if (varRelid != 0)
+			continue;
+		if (IsA(clause, RestrictInfo))
+			relids = bms_add_members(relids,
+									 ((RestrictInfo *) clause)->clause_relids);
+		else
+			relids = bms_join(relids, pull_varnos(clause));
+	}
+	if (varRelid != 0)
+		relids = bms_make_singleton(varRelid);
+
+	// only plain tables can be written into the fingerprint
+	relid = -1;
+	while ((relid = bms_next_member(relids, relid)) >= 0)
+	{
+		if (relid >= root->simple_rel_array_size ||
+			root->simple_rte_array[relid] == NULL ||
+			root->simple_rte_array[relid]->rtekind != RTE_RELATION)
+			break;
+	}
+
+	// get the fingerprint and its selectivity
+	if (relid < 0 && !bms_is_empty(relids))
+	{
+		get_clauselist_rel(root, relids, clauses);
+		new_selec = get_aimodel_clause2selectivity(sub_query);
+	}
+	bms_free(relids);
+
+	// end time
+	selectivityreplace_time += end_time(starttime);
+
+	if (new_selec == NULL)
+		return false;
+
+	*selec = atof(new_selec);
+	CLAMP_PROBABILITY(*selec);
+	return true;
+}
+
+/*
+ * batched_scalararraysel
+ *	  Estimate a large "var = ANY (const array)" restriction clause in one
+ *	  pass.  Returns false if the clause is not of that form; the caller
+ *	  falls back on scalararraysel.
+ *
+ * scalararraysel calls eqsel for every element, and so examines the variable
+ * and scans its MCV list once per element.  Here we examine the variable
+ * once, sort the elements and the MCV values with the btree ordering of the
+ * operator, and merge them.  The per-element selectivities are those of
+ * var_eq_const, and they are combined in the original element order exactly
+ * as scalararraysel does, so the result is the same.
+ */
+static bool
+batched_scalararraysel(PlannerInfo *root, ScalarArrayOpExpr *clause,
+					   int varRelid, Selectivity *selec)
+{
+	Oid			operator = clause->opno;
+	Node	   *leftop;
+	Const	   *arrayconst;
+	ArrayType  *arrayval;
+	Oid			element_type;
+	TypeCacheEntry *typentry;
+	int16		elmlen;
+	bool		elmbyval;
+	char		elmalign;
+	int			num_elems;
+	Datum	   *elem_values;
+	bool	   *elem_nulls;
+	Selectivity *elem_selecs;
+	VariableStatData vardata;
+	Node	   *other;
+	bool		varonleft;
+	double		nullfrac = 0.0;
+	Selectivity s1;
+	Selectivity s1disjoint;
+	int			i;
+
+	if (!clause->useOr || list_length(clause->args) != 2)
+		return false;
+
+	arrayconst = (Const *) lsecond(clause->args);
+	if (!IsA(arrayconst, Const) || arrayconst->constisnull)
+		return false;
+
+	/* Only the default equality of the element type, estimated by eqsel */
+	element_type = get_base_element_type(arrayconst->consttype);
+	if (!OidIsValid(element_type))
+		return false;
+	typentry = lookup_type_cache(element_type, TYPECACHE_EQ_OPR);
+	if (operator != typentry->eq_opr || get_oprrest(operator) != F_EQSEL)
+		return false;
+
+	arrayval = DatumGetArrayTypeP(arrayconst->constvalue);
+	if (ArrayGetNItems(ARR_NDIM(arrayval), ARR_DIMS(arrayval)) <
+		BATCHED_SAOP_MIN_ELEMENTS)
+		return false;
+
+	get_typlenbyvalalign(ARR_ELEMTYPE(arrayval), &elmlen, &elmbyval, &elmalign);
+	deconstruct_array(arrayval, ARR_ELEMTYPE(arrayval),
+					  elmlen, elmbyval, elmalign,
+					  &elem_values, &elem_nulls, &num_elems);
+
+	/* Examine the variable once, as eqsel would for every element */
+	leftop = estimate_expression_value(root, (Node *) linitial(clause->args));
+	if (!get_restriction_variable(root,
+								  list_make2(leftop,
+											 makeConst(element_type, -1,
+													   arrayconst->constcollid,
+													   elmlen, elem_values[0],
+													   elem_nulls[0], elmbyval)),
+								  varRelid, &vardata, &other, &varonleft))
+		return false;
+
+	if (HeapTupleIsValid(vardata.statsTuple))
+		nullfrac = ((Form_pg_statistic) GETSTRUCT(vardata.statsTuple))->stanullfrac;
+
+	elem_selecs = (Selectivity *) palloc(num_elems * sizeof(Selectivity));
+
+	if (vardata.isunique && vardata.rel && vardata.rel->tuples >= 1.0)
+	{
+		for (i = 0; i < num_elems; i++)
+			elem_selecs[i] = 1.0 / vardata.rel->tuples;
+	}
+	else if (HeapTupleIsValid(vardata.statsTuple) &&
+			 statistic_proc_security_check(&vardata, get_opcode(operator)))
+	{
+		AttStatsSlot sslot;
+		Oid			ltopr = get_ordering_op_for_equality_op(operator, false);
+		Selectivity otherselec;
+		bool		isdefault;
+		double		sumcommon = 0.0;
+		double		otherdistinct;
+
+		/* Without a btree ordering we can't merge */
+		if (!OidIsValid(ltopr) ||
+			!statistic_proc_security_check(&vardata, get_opcode(ltopr)))
+		{
+			ReleaseVariableStats(vardata);
+			pfree(elem_selecs);
+			return false;
+		}
+
+		if (!get_attstatsslot(&sslot, vardata.statsTuple,
+							  STATISTIC_KIND_MCV, InvalidOid,
+							  ATTSTATSSLOT_VALUES | ATTSTATSSLOT_NUMBERS))
+			memset(&sslot, 0, sizeof(sslot));
+
+		/* The selectivity of a value that is not among the MCVs */
+		for (i = 0; i < sslot.nnumbers; i++)
+			sumcommon += sslot.numbers[i];
+		otherselec = 1.0 - sumcommon - nullfrac;
+		CLAMP_PROBABILITY(otherselec);
+		otherdistinct = get_variable_numdistinct(&vardata, &isdefault) -
+			sslot.nnumbers;
+		if (otherdistinct > 1)
+			otherselec /= otherdistinct;
+		if (sslot.nnumbers > 0 && otherselec > sslot.numbers[sslot.nnumbers - 1])
+			otherselec = sslot.numbers[sslot.nnumbers - 1];
+
+		for (i = 0; i < num_elems; i++)
+			elem_selecs[i] = otherselec;
+
+		if (sslot.nvalues > 0)
+		{
+			SortSupportData ssup;
+			SortedDatum *elems = (SortedDatum *) palloc(num_elems * sizeof(SortedDatum));
+			SortedDatum *mcvs = (SortedDatum *) palloc(sslot.nvalues * sizeof(SortedDatum));
+			int			nelems = 0;
+			int			j = 0;
+
+			memset(&ssup, 0, sizeof(ssup));
+			ssup.ssup_cxt = CurrentMemoryContext;
+			ssup.ssup_collation = sslot.stacoll;
+			ssup.ssup_nulls_first = false;
+			PrepareSortSupportFromOrderingOp(ltopr, &ssup);
+
+			for (i = 0; i < num_elems; i++)
+			{
+				if (elem_nulls[i])
+					continue;
+				elems[nelems].value = elem_values[i];
+				elems[nelems].index = i;
+				nelems++;
+			}
+			for (i = 0; i < sslot.nvalues; i++)
+			{
+				mcvs[i].value = sslot.values[i];
+				mcvs[i].index = i;
+			}
+			qsort_arg(elems, nelems, sizeof(SortedDatum), sorted_datum_cmp, &ssup);
+			qsort_arg(mcvs, sslot.nvalues, sizeof(SortedDatum), sorted_datum_cmp, &ssup);
+
+			for (i = 0; i < nelems; i++)
+			{
+				int			cmp = -1;
+
+				while (j < sslot.nvalues &&
+					   (cmp = ApplySortComparator(mcvs[j].value, false,
+												  elems[i].value, false,
+												  &ssup)) < 0)
+					j++;
+				if (j < sslot.nvalues && cmp == 0)
+					elem_selecs[elems[i].index] = sslot.numbers[mcvs[j].index];
+			}
+
+			pfree(elems);
+			pfree(mcvs);
+		}
+
+		free_attstatsslot(&sslot);
+	}
+	else
+	{
+		bool		isdefault;
+		Selectivity s2 = 1.0 / get_variable_numdistinct(&vardata, &isdefault);
+
+		for (i = 0; i < num_elems; i++)
+			elem_selecs[i] = s2;
+	}
+
+	ReleaseVariableStats(vardata);
+
+	/* Combine the elements the same way as scalararraysel */
+	s1 = 0.0;
+	s1disjoint = 0.0;
+	for (i = 0; i < num_elems; i++)
+	{
+		Selectivity s2 = elem_nulls[i] ? 0.0 : elem_selecs[i];
+
+		CLAMP_PROBABILITY(s2);
+		s1 = s1 + s2 - s1 * s2;
+		s1disjoint += s2;
+	}
+	if (s1disjoint >= 0.0 && s1disjoint <= 1.0)
+		s1 = s1disjoint;
+
+	CLAMP_PROBABILITY(s1);
+	*selec = s1;
+
+	pfree(elem_selecs);
+	return true;
+}
+
+/*
+ * sorted_datum_cmp
+ *	  qsort_arg comparator of SortedDatums, using the given SortSupport.
+ */
+static int
+sorted_datum_cmp(const void *a, const void *b, void *arg)
+{
+	return ApplySortComparator(((const SortedDatum *) a)->value, false,
+							   ((const SortedDatum *) b)->value, false,
+							   (SortSupport) arg);
+}
+/** modification end **/
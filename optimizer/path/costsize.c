@@ -104,6 +104,102 @@
 #include "utils/hashtable.h"
 #include "utils/utils.h"
 #include "time.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+#include "utils/pilotscope_guc.h"
+#include "utils/cost_provider.h"
+#include "utils/card_model.h"
+#include "utils/card_callback.h"
+#include "catalog/pg_class.h"
+#include "optimizer/pilotscope_paths.h"
+
+/*
+ * Scan cost inputs that don't change during a planning cycle, keyed by the
+ * RelOptInfo (tablespace page costs), ParamPathInfo (cost of the pushed-down
+ * clauses) or IndexOptInfo (amcostestimate results) they belong to.
+ */
+typedef struct ScanCostCacheEntry
+{
+	void	   *key;			/* hash key --- MUST BE FIRST */
+	bool		have_page_costs;
+	double		spc_random_page_cost;
+	double		spc_seq_page_cost;
+	bool		have_qual_cost;
+	QualCost	qual_cost;
+	List	   *index_costs;	/* list of IndexCostEstimate */
+} ScanCostCacheEntry;
+
+/* The results of one amcostestimate call and the inputs they depend on */
+typedef struct IndexCostEstimate
+{
+	List	   *indexclauses;
+	List	   *indexorderbys;
+	double		loop_count;
+	Cost		indexStartupCost;
+	Cost		indexTotalCost;
+	Selectivity indexSelectivity;
+	double		indexCorrelation;
+	double		index_pages;
+} IndexCostEstimate;
+
+/* Don't keep more than this many estimates per index */
+#define MAX_INDEX_COST_ESTIMATES	32
+
+static HTAB *scan_cost_cache = NULL;
+static int	scan_cost_cache_cycle = 0;
+
+/*
+ * Hash join costing inputs that only depend on the inner side, keyed by the
+ * inner rel, so that the hash join paths with different outer paths or
+ * inner paths of the same rel share them.
+ */
+typedef struct HashJoinStatsEntry
+{
+	RelOptInfo *inner_rel;		/* hash key --- MUST BE FIRST */
+	List	   *bucket_stats;	/* list of HashBucketStats */
+	List	   *table_sizes;	/* list of HashTableSize */
+} HashJoinStatsEntry;
+
+/* Bucket size and MCV frequency of the inner side for a hash clause set */
+typedef struct HashBucketStats
+{
+	List	   *hashclauses;
+	Selectivity innerbucketsize;
+	Selectivity innermcvfreq;
+} HashBucketStats;
+
+/* The results of ExecChooseHashTableSize and the inputs they depend on */
+typedef struct HashTableSize
+{
+	double		ntuples;
+	int			tupwidth;
+	bool		try_combined_hash_mem;
+	int			parallel_workers;
+	size_t		space_allowed;
+	int			numbuckets;
+	int			numbatches;
+	int			num_skew_mcvs;
+} HashTableSize;
+
+/* Don't keep more than this many entries per list */
+#define MAX_HASH_JOIN_STATS		32
+
+static HTAB *hash_join_stats_cache = NULL;
+static int	hash_join_stats_cache_cycle = 0;
+
+/*
+ * The subqueries captured for subquery_card_fetcher_anchor, by the relids of
+ * the rel they were captured for.  The same rel may be sized several times,
+ * e.g. once per GEQO tour, and each subquery is sent only once.
+ */
+typedef struct CapturedSubqueryEntry
+{
+	Relids		relids;			/* hash key --- MUST BE FIRST */
+	List	   *positions;		/* integer positions in pilot_transdata->subquery */
+} CapturedSubqueryEntry;
+
+static HTAB *captured_subqueries = NULL;
+static int	captured_subquery_capacity = 0;
 /** modification end **/
 
 #define LOG2(x)  (log(x) / 0.693147180559945)
@@ -186,6 +282,34 @@ static void set_rel_width(PlannerInfo *root, RelOptInfo *rel);
 static double relation_byte_size(double tuples, int width);
 static double page_size(double tuples, int width);
 static double get_parallel_divisor(Path *path);
+/** modification start **/
+static ScanCostCacheEntry *get_scan_cost_cache_entry(PlannerInfo *root,
+													 void *key);
+static void get_rel_page_costs(PlannerInfo *root, RelOptInfo *baserel,
+							   double *spc_random_page_cost,
+							   double *spc_seq_page_cost);
+static bool same_list_members(List *a, List *b);
+static HashJoinStatsEntry *get_hash_join_stats_entry(PlannerInfo *root,
+													 RelOptInfo *inner_rel);
+static void apply_cost_provider(CostOp op, Path *path, double outer_rows,
+								double inner_rows, int width);
+static double card_model_baserel_rows(PlannerInfo *root, RelOptInfo *rel,
+									  double nrows);
+static double card_model_joinrel_rows(RelOptInfo *joinrel, double outer_rows,
+									  double inner_rows, JoinType jointype,
+									  int nclauses, double nrows);
+static void choose_hash_table_size(HashJoinStatsEntry *entry, double ntuples,
+								   int tupwidth, bool try_combined_hash_mem,
+								   int parallel_workers,
+								   size_t *space_allowed, int *numbuckets,
+								   int *numbatches, int *num_skew_mcvs);
+static void estimate_index_cost(PlannerInfo *root, IndexPath *path,
+								double loop_count,
+								Cost *indexStartupCost, Cost *indexTotalCost,
+								Selectivity *indexSelectivity,
+								double *indexCorrelation,
+								double *index_pages);
+/** modification end **/
 
 /*
  * clamp_row_est
@@ -240,9 +364,9 @@ cost_seqscan(Path *path, PlannerInfo *root,
 		startup_cost += disable_cost;
 
 	/* fetch estimated page cost for tablespace containing table */
-	get_tablespace_page_costs(baserel->reltablespace,
-							  NULL,
-							  &spc_seq_page_cost);
+	/** modification start **/
+	get_rel_page_costs(root, baserel, NULL, &spc_seq_page_cost);
+	/** modification end **/
 
 	/*
 	 * disk costs
@@ -283,6 +407,12 @@ cost_seqscan(Path *path, PlannerInfo *root,
 
 	path->startup_cost = startup_cost;
 	path->total_cost = startup_cost + cpu_run_cost + disk_run_cost;
+
+	/** modification start **/
+	if (enable_cost_provider)
+		apply_cost_provider(COST_OP_SEQSCAN, path, baserel->tuples, 0,
+							path->pathtarget->width);
+	/** modification end **/
 }
 
 /*
@@ -549,11 +679,23 @@ cost_index(IndexPath *path, PlannerInfo *root, double loop_count,
 	 * correlation to the main-table tuple order.  We need a cast here because
 	 * pathnodes.h uses a weak function type to avoid including amapi.h.
 	 */
+	/** modification start **/
+	if (enable_scan_cost_cache)
+		estimate_index_cost(root, path, loop_count,
+							&indexStartupCost, &indexTotalCost,
+							&indexSelectivity, &indexCorrelation,
+							&index_pages);
+	else
+	{
+	/** modification end **/
 	amcostestimate = (amcostestimate_function) index->amcostestimate;
 	amcostestimate(root, path, loop_count,
 				   &indexStartupCost, &indexTotalCost,
 				   &indexSelectivity, &indexCorrelation,
 				   &index_pages);
+	/** modification start **/
+	}
+	/** modification end **/
 
 	/*
 	 * Save amcostestimate's results for possible use in bitmap scan planning.
@@ -571,9 +713,10 @@ cost_index(IndexPath *path, PlannerInfo *root, double loop_count,
 	tuples_fetched = clamp_row_est(indexSelectivity * baserel->tuples);
 
 	/* fetch estimated page costs for tablespace containing table */
-	get_tablespace_page_costs(baserel->reltablespace,
-							  &spc_random_page_cost,
-							  &spc_seq_page_cost);
+	/** modification start **/
+	get_rel_page_costs(root, baserel,
+					   &spc_random_page_cost, &spc_seq_page_cost);
+	/** modification end **/
 
 	/*----------
 	 * Estimate number of main-table pages fetched, and compute I/O cost.
@@ -753,6 +896,12 @@ cost_index(IndexPath *path, PlannerInfo *root, double loop_count,
 
 	path->path.startup_cost = startup_cost;
 	path->path.total_cost = startup_cost + run_cost;
+
+	/** modification start **/
+	if (enable_cost_provider)
+		apply_cost_provider(COST_OP_INDEX, &path->path, baserel->tuples, 0,
+							path->path.pathtarget->width);
+	/** modification end **/
 }
 
 /*
@@ -984,9 +1133,10 @@ cost_bitmap_heap_scan(Path *path, PlannerInfo *root, RelOptInfo *baserel,
 	T = (baserel->pages > 1) ? (double) baserel->pages : 1.0;
 
 	/* Fetch estimated page costs for tablespace containing table. */
-	get_tablespace_page_costs(baserel->reltablespace,
-							  &spc_random_page_cost,
-							  &spc_seq_page_cost);
+	/** modification start **/
+	get_rel_page_costs(root, baserel,
+					   &spc_random_page_cost, &spc_seq_page_cost);
+	/** modification end **/
 
 	/*
 	 * For small numbers of pages we should charge spc_random_page_cost
@@ -1952,6 +2102,11 @@ cost_sort(Path *path, PlannerInfo *root,
 	path->rows = tuples;
 	path->startup_cost = startup_cost;
 	path->total_cost = startup_cost + run_cost;
+
+	/** modification start **/
+	if (enable_cost_provider)
+		apply_cost_provider(COST_OP_SORT, path, tuples, 0, width);
+	/** modification end **/
 }
 
 /*
@@ -2500,6 +2655,16 @@ cost_agg(Path *path, PlannerInfo *root,
 	path->rows = output_tuples;
 	path->startup_cost = startup_cost;
 	path->total_cost = total_cost;
+
+	/** modification start **/
+	/*
+	 * Callers pass dummy paths without a pathtarget, so the width is the
+	 * input width for aggregation (see COST_FEATURE_WIDTH).
+	 */
+	if (enable_cost_provider)
+		apply_cost_provider(COST_OP_AGG, path, input_tuples, 0,
+							(int) input_width);
+	/** modification end **/
 }
 
 /*
@@ -2903,6 +3068,12 @@ final_cost_nestloop(PlannerInfo *root, NestPath *path,
 
 	path->path.startup_cost = startup_cost;
 	path->path.total_cost = startup_cost + run_cost;
+
+	/** modification start **/
+	if (enable_cost_provider)
+		apply_cost_provider(COST_OP_NESTLOOP, &path->path, outer_path->rows,
+							inner_path->rows, path->path.pathtarget->width);
+	/** modification end **/
 }
 
 /*
@@ -3411,6 +3582,13 @@ final_cost_mergejoin(PlannerInfo *root, MergePath *path,
 
 	path->jpath.path.startup_cost = startup_cost;
 	path->jpath.path.total_cost = startup_cost + run_cost;
+
+	/** modification start **/
+	if (enable_cost_provider)
+		apply_cost_provider(COST_OP_MERGEJOIN, &path->jpath.path,
+							outer_path->rows, inner_path->rows,
+							path->jpath.path.pathtarget->width);
+	/** modification end **/
 }
 
 /*
@@ -3552,6 +3730,20 @@ initial_cost_hashjoin(PlannerInfo *root, JoinCostWorkspace *workspace,
 	 * XXX at some point it might be interesting to try to account for skew
 	 * optimization in the cost estimate, but for now, we don't.
 	 */
+	/** modification start **/
+	if (enable_hash_join_stats_cache)
+		choose_hash_table_size(get_hash_join_stats_entry(root,
+														 inner_path->parent),
+							   inner_path_rows_total,
+							   inner_path->pathtarget->width,
+							   parallel_hash,
+							   outer_path->parallel_workers,
+							   &space_allowed,
+							   &numbuckets,
+							   &numbatches,
+							   &num_skew_mcvs);
+	else
+	/** modification end **/
 	ExecChooseHashTableSize(inner_path_rows_total,
 							inner_path->pathtarget->width,
 							true,	/* useskew */
@@ -3677,6 +3869,38 @@ final_cost_hashjoin(PlannerInfo *root, HashPath *path,
 	}
 	else
 	{
+		/** modification start **/
+		HashJoinStatsEntry *entry = NULL;
+		HashBucketStats *stats = NULL;
+
+		/*
+		 * The estimates below only depend on the inner rel and the hash
+		 * clauses, so look for the result of an earlier path of the rel.
+		 */
+		if (enable_hash_join_stats_cache)
+			entry = get_hash_join_stats_entry(root, inner_path->parent);
+		if (entry != NULL)
+		{
+			foreach(hcl, entry->bucket_stats)
+			{
+				HashBucketStats *prev = (HashBucketStats *) lfirst(hcl);
+
+				if (same_list_members(prev->hashclauses, hashclauses))
+				{
+					stats = prev;
+					break;
+				}
+			}
+		}
+
+		if (stats != NULL)
+		{
+			innerbucketsize = stats->innerbucketsize;
+			innermcvfreq = stats->innermcvfreq;
+		}
+		else
+		{
+		/** modification end **/
 		innerbucketsize = 1.0;
 		innermcvfreq = 1.0;
 		foreach(hcl, hashclauses)
@@ -3734,6 +3958,18 @@ final_cost_hashjoin(PlannerInfo *root, HashPath *path,
 			if (innermcvfreq > thismcvfreq)
 				innermcvfreq = thismcvfreq;
 		}
+		/** modification start **/
+			if (entry != NULL &&
+				list_length(entry->bucket_stats) < MAX_HASH_JOIN_STATS)
+			{
+				stats = (HashBucketStats *) palloc(sizeof(HashBucketStats));
+				stats->hashclauses = list_copy(hashclauses);
+				stats->innerbucketsize = innerbucketsize;
+				stats->innermcvfreq = innermcvfreq;
+				entry->bucket_stats = lappend(entry->bucket_stats, stats);
+			}
+		}
+		/** modification end **/
 	}
 
 	/*
@@ -3850,6 +4086,13 @@ final_cost_hashjoin(PlannerInfo *root, HashPath *path,
 
 	path->jpath.path.startup_cost = startup_cost;
 	path->jpath.path.total_cost = startup_cost + run_cost;
+
+	/** modification start **/
+	if (enable_cost_provider)
+		apply_cost_provider(COST_OP_HASHJOIN, &path->jpath.path,
+							outer_path->rows, inner_path->rows,
+							path->jpath.path.pathtarget->width);
+	/** modification end **/
 }
 
 
@@ -4353,8 +4596,24 @@ get_restriction_qual_cost(PlannerInfo *root, RelOptInfo *baserel,
 {
 	if (param_info)
 	{
+		/** modification start **/
+		ScanCostCacheEntry *entry = get_scan_cost_cache_entry(root, param_info);
+
+		if (entry != NULL && entry->have_qual_cost)
+			*qpqual_cost = entry->qual_cost;
+		else
+		{
+		/** modification end **/
 		/* Include costs of pushed-down clauses */
 		cost_qual_eval(qpqual_cost, param_info->ppi_clauses, root);
+		/** modification start **/
+			if (entry != NULL)
+			{
+				entry->qual_cost = *qpqual_cost;
+				entry->have_qual_cost = true;
+			}
+		}
+		/** modification end **/
 
 		qpqual_cost->startup += baserel->baserestrictcost.startup;
 		qpqual_cost->per_tuple += baserel->baserestrictcost.per_tuple;
@@ -4364,6 +4623,407 @@ get_restriction_qual_cost(PlannerInfo *root, RelOptInfo *baserel,
 }
 
 
+/** modification start **/
+/*
+ * get_scan_cost_cache_entry
+ *	  Return the scan cost cache entry of the given planner object, or NULL if
+ *	  pilotscope.enable_scan_cost_cache is off or we can't cache here.
+ *
+ * The cache lives in the planner context and is only valid for the planning
+ * cycle that built it; objects built in a GEQO temporary context are not
+ * cached, since their addresses may be reused.
+ */
+static ScanCostCacheEntry *
+get_scan_cost_cache_entry(PlannerInfo *root, void *key)
+{
+	ScanCostCacheEntry *entry;
+	bool		found;
+
+	if (!enable_scan_cost_cache || CurrentMemoryContext != root->planner_cxt)
+		return NULL;
+
+	/* The caches of former planning cycles are gone with their contexts */
+	if (scan_cost_cache == NULL || scan_cost_cache_cycle != planning_cycle)
+	{
+		HASHCTL		hash_ctl;
+
+		MemSet(&hash_ctl, 0, sizeof(hash_ctl));
+		hash_ctl.keysize = sizeof(void *);
+		hash_ctl.entrysize = sizeof(ScanCostCacheEntry);
+		hash_ctl.hcxt = root->planner_cxt;
+		scan_cost_cache = hash_create("Scan cost cache", 256, &hash_ctl,
+									  HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+		scan_cost_cache_cycle = planning_cycle;
+	}
+
+	entry = (ScanCostCacheEntry *) hash_search(scan_cost_cache, &key,
+											   HASH_ENTER, &found);
+	if (!found)
+	{
+		entry->have_page_costs = false;
+		entry->have_qual_cost = false;
+		entry->index_costs = NIL;
+	}
+
+	return entry;
+}
+
+/*
+ * get_rel_page_costs
+ *	  get_tablespace_page_costs for the tablespace of baserel, remembered on
+ *	  the rel for the rest of the planning cycle.
+ */
+static void
+get_rel_page_costs(PlannerInfo *root, RelOptInfo *baserel,
+				   double *spc_random_page_cost, double *spc_seq_page_cost)
+{
+	ScanCostCacheEntry *entry = get_scan_cost_cache_entry(root, baserel);
+
+	if (entry == NULL)
+	{
+		get_tablespace_page_costs(baserel->reltablespace,
+								  spc_random_page_cost,
+								  spc_seq_page_cost);
+		return;
+	}
+
+	if (!entry->have_page_costs)
+	{
+		get_tablespace_page_costs(baserel->reltablespace,
+								  &entry->spc_random_page_cost,
+								  &entry->spc_seq_page_cost);
+		entry->have_page_costs = true;
+	}
+
+	if (spc_random_page_cost)
+		*spc_random_page_cost = entry->spc_random_page_cost;
+	if (spc_seq_page_cost)
+		*spc_seq_page_cost = entry->spc_seq_page_cost;
+}
+
+/*
+ * Check whether two lists have the very same members
+ */
+static bool
+same_list_members(List *a, List *b)
+{
+	ListCell   *lca;
+	ListCell   *lcb;
+
+	if (list_length(a) != list_length(b))
+		return false;
+
+	forboth(lca, a, lcb, b)
+	{
+		if (lfirst(lca) != lfirst(lcb))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * estimate_index_cost
+ *	  Call the amcostestimate of the index of path, reusing the results of an
+ *	  earlier call with the same inputs.
+ *
+ * Index paths differing only in scan direction, parallelism or the use in a
+ * bitmap scan share their IndexClauses (see build_index_paths), and so the
+ * results of amcostestimate, which only depend on the index, the index
+ * clauses and order-by expressions and the loop count.
+ */
+static void
+estimate_index_cost(PlannerInfo *root, IndexPath *path, double loop_count,
+					Cost *indexStartupCost, Cost *indexTotalCost,
+					Selectivity *indexSelectivity, double *indexCorrelation,
+					double *index_pages)
+{
+	IndexOptInfo *index = path->indexinfo;
+	amcostestimate_function amcostestimate;
+	ScanCostCacheEntry *entry = get_scan_cost_cache_entry(root, index);
+	IndexCostEstimate *estimate = NULL;
+	ListCell   *lc;
+
+	if (entry != NULL)
+	{
+		foreach(lc, entry->index_costs)
+		{
+			IndexCostEstimate *e = (IndexCostEstimate *) lfirst(lc);
+
+			if (e->loop_count == loop_count &&
+				same_list_members(e->indexclauses, path->indexclauses) &&
+				same_list_members(e->indexorderbys, path->indexorderbys))
+			{
+				estimate = e;
+				break;
+			}
+		}
+	}
+
+	if (estimate == NULL)
+	{
+		amcostestimate = (amcostestimate_function) index->amcostestimate;
+		amcostestimate(root, path, loop_count,
+					   indexStartupCost, indexTotalCost,
+					   indexSelectivity, indexCorrelation,
+					   index_pages);
+
+		if (entry == NULL ||
+			list_length(entry->index_costs) >= MAX_INDEX_COST_ESTIMATES)
+			return;
+
+		estimate = (IndexCostEstimate *) palloc(sizeof(IndexCostEstimate));
+		estimate->indexclauses = list_copy(path->indexclauses);
+		estimate->indexorderbys = list_copy(path->indexorderbys);
+		estimate->loop_count = loop_count;
+		estimate->indexStartupCost = *indexStartupCost;
+		estimate->indexTotalCost = *indexTotalCost;
+		estimate->indexSelectivity = *indexSelectivity;
+		estimate->indexCorrelation = *indexCorrelation;
+		estimate->index_pages = *index_pages;
+		entry->index_costs = lappend(entry->index_costs, estimate);
+		return;
+	}
+
+	*indexStartupCost = estimate->indexStartupCost;
+	*indexTotalCost = estimate->indexTotalCost;
+	*indexSelectivity = estimate->indexSelectivity;
+	*indexCorrelation = estimate->indexCorrelation;
+	*index_pages = estimate->index_pages;
+}
+
+/*
+ * apply_cost_provider
+ *	  Replace the costs the formulas computed for path by those of the cost
+ *	  provider, if it has a model for op (see "utils/cost_provider.c").
+ *
+ * Each path is estimated on its own, since add_path needs its costs at once.
+ */
+static void
+apply_cost_provider(CostOp op, Path *path, double outer_rows,
+					double inner_rows, int width)
+{
+	double		features[NUM_COST_FEATURES];
+
+	if (!cost_provider_handles(op))
+		return;
+
+	features[COST_FEATURE_BIAS] = 1.0;
+	features[COST_FEATURE_STARTUP_COST] = path->startup_cost;
+	features[COST_FEATURE_TOTAL_COST] = path->total_cost;
+	features[COST_FEATURE_ROWS] = path->rows;
+	features[COST_FEATURE_OUTER_ROWS] = outer_rows;
+	features[COST_FEATURE_INNER_ROWS] = inner_rows;
+	features[COST_FEATURE_WIDTH] = width;
+
+	cost_provider_estimate(op, 1, features,
+						   &path->startup_cost, &path->total_cost);
+}
+
+/*
+ * card_model_baserel_rows
+ *	  Estimate the rows of a base rel with the cardinality model of
+ *	  "utils/card_model.c", returning nrows if there is no model.
+ */
+static double
+card_model_baserel_rows(PlannerInfo *root, RelOptInfo *rel, double nrows)
+{
+	RangeTblEntry *rte = planner_rt_fetch(rel->relid, root);
+	double		features[NUM_CARD_FEATURES];
+	double		model_rows;
+
+	features[CARD_FEATURE_NRELS] = 1;
+	features[CARD_FEATURE_RELOID] =
+		rte->rtekind == RTE_RELATION ? (double) rte->relid : 0;
+	features[CARD_FEATURE_LOG_PG_ROWS] = log1p(Max(nrows, 0));
+	features[CARD_FEATURE_LOG_OUTER_ROWS] = log1p(Max(rel->tuples, 0));
+	features[CARD_FEATURE_LOG_INNER_ROWS] = 0;
+	features[CARD_FEATURE_NCLAUSES] = list_length(rel->baserestrictinfo);
+	features[CARD_FEATURE_JOINTYPE] = JOIN_INNER;
+
+	if (!card_model_predict(features, &model_rows))
+		return nrows;
+	return model_rows;
+}
+
+/*
+ * card_model_joinrel_rows
+ *	  Estimate the rows of a join with the cardinality model, returning nrows
+ *	  if there is no model.
+ */
+static double
+card_model_joinrel_rows(RelOptInfo *joinrel, double outer_rows,
+						double inner_rows, JoinType jointype, int nclauses,
+						double nrows)
+{
+	double		features[NUM_CARD_FEATURES];
+	double		model_rows;
+
+	features[CARD_FEATURE_NRELS] = bms_num_members(joinrel->relids);
+	features[CARD_FEATURE_RELOID] = 0;
+	features[CARD_FEATURE_LOG_PG_ROWS] = log1p(Max(nrows, 0));
+	features[CARD_FEATURE_LOG_OUTER_ROWS] = log1p(Max(outer_rows, 0));
+	features[CARD_FEATURE_LOG_INNER_ROWS] = log1p(Max(inner_rows, 0));
+	features[CARD_FEATURE_NCLAUSES] = nclauses;
+	features[CARD_FEATURE_JOINTYPE] = jointype;
+
+	if (!card_model_predict(features, &model_rows))
+		return nrows;
+	return model_rows;
+}
+
+/*
+ * card_callback_base_rels
+ *	  Ask the python side for the cards of the plain base rels in one
+ *	  request, and set their rows to the answers.
+ *
+ * Called once all base rels are sized, so that the subqueries planned while
+ * sizing them may ask for their own cards.  Rels whose card was given by
+ * card_replace_anchor keep it.
+ */
+void
+card_callback_base_rels(PlannerInfo *root)
+{
+	Index		rti;
+
+	if (!card_callback_active() || !card_callback_begin(root))
+		return;
+
+	for (rti = 1; rti < root->simple_rel_array_size; rti++)
+	{
+		RelOptInfo *rel = root->simple_rel_array[rti];
+		RangeTblEntry *rte;
+
+		if (rel == NULL || rel->reloptkind != RELOPT_BASEREL ||
+			IS_DUMMY_REL(rel))
+			continue;
+
+		/* only the rels sized by set_plain_rel_size alone */
+		rte = root->simple_rte_array[rti];
+		if (rte->rtekind != RTE_RELATION || rte->inh ||
+			rte->relkind == RELKIND_FOREIGN_TABLE ||
+			rte->tablesample != NULL)
+			continue;
+
+		get_single_rel(root, rel);
+		if (card_replace_anchor != NULL && card_replace_anchor->enable == 1 &&
+			get_aimodel_subquery2card(table, sub_query) != NULL)
+			continue;
+
+		rel->rows = clamp_row_est(card_callback_rows(root, sub_query,
+													  &rel->rows, rel->rows));
+	}
+
+	card_callback_end(root);
+}
+
+/*
+ * get_hash_join_stats_entry
+ *	  Return the hash join costing entry of the given inner rel, or NULL if
+ *	  we can't cache here.
+ *
+ * As for the scan cost cache, the entries are valid for one planning cycle
+ * and join rels of GEQO's temporary contexts are left out.
+ */
+static HashJoinStatsEntry *
+get_hash_join_stats_entry(PlannerInfo *root, RelOptInfo *inner_rel)
+{
+	HashJoinStatsEntry *entry;
+	bool		found;
+
+	if (CurrentMemoryContext != root->planner_cxt)
+		return NULL;
+
+	if (hash_join_stats_cache == NULL ||
+		hash_join_stats_cache_cycle != planning_cycle)
+	{
+		HASHCTL		hash_ctl;
+
+		MemSet(&hash_ctl, 0, sizeof(hash_ctl));
+		hash_ctl.keysize = sizeof(RelOptInfo *);
+		hash_ctl.entrysize = sizeof(HashJoinStatsEntry);
+		hash_ctl.hcxt = root->planner_cxt;
+		hash_join_stats_cache = hash_create("Hash join stats cache", 256,
+											&hash_ctl,
+											HASH_ELEM | HASH_BLOBS |
+											HASH_CONTEXT);
+		hash_join_stats_cache_cycle = planning_cycle;
+	}
+
+	entry = (HashJoinStatsEntry *) hash_search(hash_join_stats_cache,
+											   &inner_rel, HASH_ENTER, &found);
+	if (!found)
+	{
+		entry->bucket_stats = NIL;
+		entry->table_sizes = NIL;
+	}
+
+	return entry;
+}
+
+/*
+ * choose_hash_table_size
+ *	  ExecChooseHashTableSize with skew optimization, reusing the results of
+ *	  an earlier call with the same inputs for the same inner rel.
+ *
+ * 'entry' may be NULL, in which case nothing is remembered.
+ */
+static void
+choose_hash_table_size(HashJoinStatsEntry *entry, double ntuples,
+					   int tupwidth, bool try_combined_hash_mem,
+					   int parallel_workers,
+					   size_t *space_allowed, int *numbuckets,
+					   int *numbatches, int *num_skew_mcvs)
+{
+	HashTableSize *size;
+	ListCell   *lc;
+
+	if (entry != NULL)
+	{
+		foreach(lc, entry->table_sizes)
+		{
+			size = (HashTableSize *) lfirst(lc);
+
+			if (size->ntuples == ntuples &&
+				size->tupwidth == tupwidth &&
+				size->try_combined_hash_mem == try_combined_hash_mem &&
+				size->parallel_workers == parallel_workers)
+			{
+				*space_allowed = size->space_allowed;
+				*numbuckets = size->numbuckets;
+				*numbatches = size->numbatches;
+				*num_skew_mcvs = size->num_skew_mcvs;
+				return;
+			}
+		}
+	}
+
+	ExecChooseHashTableSize(ntuples, tupwidth,
+							true,	/* useskew */
+							try_combined_hash_mem,
+							parallel_workers,
+							space_allowed,
+							numbuckets,
+							numbatches,
+							num_skew_mcvs);
+
+	if (entry == NULL ||
+		list_length(entry->table_sizes) >= MAX_HASH_JOIN_STATS)
+		return;
+
+	size = (HashTableSize *) palloc(sizeof(HashTableSize));
+	size->ntuples = ntuples;
+	size->tupwidth = tupwidth;
+	size->try_combined_hash_mem = try_combined_hash_mem;
+	size->parallel_workers = parallel_workers;
+	size->space_allowed = *space_allowed;
+	size->numbuckets = *numbuckets;
+	size->numbatches = *numbatches;
+	size->num_skew_mcvs = *num_skew_mcvs;
+	entry->table_sizes = lappend(entry->table_sizes, size);
+}
+/** modification end **/
+
 /*
  * compute_semi_anti_join_factors
  *	  Estimate how much of the inner input a SEMI, ANTI, or inner_unique join
@@ -4632,21 +5292,76 @@ approx_tuple_count(PlannerInfo *root, JoinPath *path, List *quals)
 }
 
 /** modification start **/
-// get subquery and card
-void get_subquery_and_card(double nrows)
+// get subquery and card, unless the same subquery was got for relids before
+void get_subquery_and_card(Relids relids, double nrows)
 {
-		int curr_subquery_length = 0;
-		int curr_card_length = 0;
+		// keep the captures with pilot_transdata, not in GEQO's temporary contexts
+		MemoryContext cxt = PilotScopeQueryContext;
+		MemoryContext oldcxt;
+		CapturedSubqueryEntry* entry;
+		bool found;
+		ListCell* lc;
+
+		// the first capture of a query starts over
+		if(subquery_count == 0 || captured_subqueries == NULL)
+		{
+			HASHCTL hash_ctl;
+
+			MemSet(&hash_ctl, 0, sizeof(hash_ctl));
+			hash_ctl.keysize = sizeof(Relids);
+			hash_ctl.entrysize = sizeof(CapturedSubqueryEntry);
+			hash_ctl.hash = bitmap_hash;
+			hash_ctl.match = bitmap_match;
+			hash_ctl.hcxt = cxt;
+			captured_subqueries = hash_create("Captured subqueries", 256, &hash_ctl,
+											  HASH_ELEM | HASH_FUNCTION | HASH_COMPARE | HASH_CONTEXT);
+			captured_subquery_capacity = 0;
+		}
+
+		// skip the subquery if relids already has it
+		entry = (CapturedSubqueryEntry*) hash_search(captured_subqueries, &relids, HASH_ENTER, &found);
+		if(!found)
+		{
+			oldcxt = MemoryContextSwitchTo(cxt);
+			entry->relids = bms_copy(relids);
+			entry->positions = NIL;
+			MemoryContextSwitchTo(oldcxt);
+		}
+		foreach(lc, entry->positions)
+		{
+			if(strcmp(pilot_transdata->subquery[lfirst_int(lc)], sub_query) == 0)
+			{
+				return;
+			}
+		}
+
+		oldcxt = MemoryContextSwitchTo(cxt);
+
+		// grow the arrays geometrically
+		if(subquery_count == captured_subquery_capacity)
+		{
+			captured_subquery_capacity = Max(64, captured_subquery_capacity * 2);
+			if(pilot_transdata->subquery == NULL)
+			{
+				pilot_transdata->subquery = (char**) palloc(captured_subquery_capacity * sizeof(char*));
+				pilot_transdata->card = (char**) palloc(captured_subquery_capacity * sizeof(char*));
+			}
+			else
+			{
+				pilot_transdata->subquery = (char**) repalloc(pilot_transdata->subquery, captured_subquery_capacity * sizeof(char*));
+				pilot_transdata->card = (char**) repalloc(pilot_transdata->card, captured_subquery_capacity * sizeof(char*));
+			}
+		}
 
-		relloc_string_array_object(pilot_transdata->subquery,subquery_count+2);
-		relloc_string_array_object(pilot_transdata->card,subquery_count+2);
-		
 		//store  subquery 
 		store_string(sub_query,pilot_transdata->subquery[subquery_count]);
 
 		// store card
 		store_string_for_num(nrows,pilot_transdata->card[subquery_count]);
 
+		entry->positions = lappend_int(entry->positions, subquery_count);
+		MemoryContextSwitchTo(oldcxt);
+
 		// update subquery num
 		++subquery_count;
 }
@@ -4687,13 +5402,19 @@ set_baserel_size_estimates(PlannerInfo *root, RelOptInfo *rel)
 
 		// get subquery
 		get_single_rel(root, rel);
-		get_subquery_and_card(nrows);
+		get_subquery_and_card(rel->relids, nrows);
 
 		// end time
 		subquerycardfetcher_time += end_time(starttime);
 
 	}
 
+	// estimate with the cardinality model, unless replaced below
+	if(enable_card_model)
+	{
+		nrows = card_model_baserel_rows(root, rel, nrows);
+	}
+
 	// set single-table subquery card
 	if(card_replace_anchor != NULL && card_replace_anchor->enable == 1)
 	{
@@ -4871,6 +5592,9 @@ calc_joinrel_size_estimate(PlannerInfo *root,
 	Selectivity jselec;
 	Selectivity pselec;
 	double		nrows;
+	/** modification start **/
+	bool		card_replaced = false;
+	/** modification end **/
 
 	/*
 	 * Compute joinclause selectivity.  Note that we are only considering
@@ -4997,12 +5721,20 @@ calc_joinrel_size_estimate(PlannerInfo *root,
 
 		// get subquery
 		get_join_rel(root, joinrel, inner_rel, outer_rel, restrictlist);
-		get_subquery_and_card(nrows);
+		get_subquery_and_card(joinrel->relids, nrows);
 
 		// end time
 		subquerycardfetcher_time += end_time(starttime);
 	}
 
+	// estimate with the cardinality model, unless replaced below
+	if(enable_card_model)
+	{
+		nrows = card_model_joinrel_rows(joinrel, outer_rows, inner_rows,
+										jointype, list_length(restrictlist_in),
+										nrows);
+	}
+
 	// set multi-table subquery card
 	if(card_replace_anchor != NULL && card_replace_anchor->enable == 1)
 	{
@@ -5017,11 +5749,24 @@ calc_joinrel_size_estimate(PlannerInfo *root,
 		if(new_rows != NULL)
 		{
 			nrows = atof(new_rows);
+			card_replaced = true;
 		}
 
 		// end time
 		cardreplace_time += end_time(starttime);
 	}
+
+	/*
+	 * Ask the python side for the card while planning, unless replaced above.
+	 * Only the sizing pass of a level of standard_join_search collects the
+	 * subquery; there we are called by set_joinrel_size_estimates, whose rows
+	 * get the card at the end of the pass.
+	 */
+	if(!card_replaced && card_callback_active())
+	{
+		get_join_rel(root, joinrel, inner_rel, outer_rel, restrictlist);
+		nrows = card_callback_rows(root, sub_query, &joinrel->rows, nrows);
+	}
 	/** modification end **/
 
 
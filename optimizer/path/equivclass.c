@@ -30,6 +30,43 @@
 #include "optimizer/planmain.h"
 #include "optimizer/restrictinfo.h"
 #include "utils/lsyscache.h"
+/** modification start **/
+#include "anchor2struct.h"
+#include "optimizer/pilotscope_paths.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+
+/*
+ * Index of the members of a large EquivalenceClass, by position in
+ * ec_members: the non-child members, and the child members per relid of
+ * their em_relids.  With partitioned tables an EC holds a child member per
+ * partition, of which a lookup for some rels needs just a few.
+ *
+ * Members are only ever appended to ec_members (merging ECs appends the
+ * members of one to the other and empties the other), so the index covers
+ * a prefix of the list and catches up lazily.  It is rebuilt if the list
+ * changed under it.
+ */
+#define EC_MEMBER_INDEX_MIN_MEMBERS 16
+
+typedef struct ECMemberIndex
+{
+	EquivalenceClass *ec;		/* hash key --- MUST BE FIRST */
+	int			nindexed;		/* number of ec_members indexed */
+	EquivalenceMember *last_em; /* ec_members member nindexed - 1 */
+	Bitmapset  *parents;		/* positions of the non-child members */
+	int			nbuckets;		/* allocated length of children */
+	Bitmapset **children;		/* positions of the child members per relid */
+} ECMemberIndex;
+
+/* The indexes of the current planning cycle, keyed by EC */
+static HTAB *ec_member_indexes = NULL;
+static int	ec_member_indexes_cycle = 0;
+
+static ECMemberIndex *get_ec_member_index(EquivalenceClass *ec);
+static void add_ec_member_index_entry(ECMemberIndex *index,
+									  EquivalenceMember *em, int position);
+/** modification end **/
 
 
 static EquivalenceMember *add_eq_member(EquivalenceClass *ec,
@@ -640,7 +677,10 @@ get_eclass_for_sort_expr(PlannerInfo *root,
 	foreach(lc1, root->eq_classes)
 	{
 		EquivalenceClass *cur_ec = (EquivalenceClass *) lfirst(lc1);
-		ListCell   *lc2;
+		/** modification start **/
+		ECMemberIterator it;
+		EquivalenceMember *cur_em;
+		/** modification end **/
 
 		/*
 		 * Never match to a volatile EC, except when we are looking at another
@@ -655,10 +695,11 @@ get_eclass_for_sort_expr(PlannerInfo *root,
 		if (!equal(opfamilies, cur_ec->ec_opfamilies))
 			continue;
 
-		foreach(lc2, cur_ec->ec_members)
+		/** modification start **/
+		ec_member_iterator_begin(&it, cur_ec, rel);
+		while ((cur_em = ec_member_iterator_next(&it)) != NULL)
 		{
-			EquivalenceMember *cur_em = (EquivalenceMember *) lfirst(lc2);
-
+			/** modification end **/
 			/*
 			 * Ignore child members unless they match the request.
 			 */
@@ -676,7 +717,12 @@ get_eclass_for_sort_expr(PlannerInfo *root,
 
 			if (opcintype == cur_em->em_datatype &&
 				equal(expr, cur_em->em_expr))
+			{
+				/** modification start **/
+				ec_member_iterator_end(&it);
+				/** modification end **/
 				return cur_ec;	/* Match! */
+			}
 		}
 	}
 
@@ -1372,6 +1418,10 @@ generate_join_implied_equalities_normal(PlannerInfo *root,
 	List	   *outer_members = NIL;
 	List	   *inner_members = NIL;
 	ListCell   *lc1;
+	/** modification start **/
+	ECMemberIterator it;
+	EquivalenceMember *cur_em;
+	/** modification end **/
 
 	/*
 	 * First, scan the EC to identify member values that are computable at the
@@ -1382,10 +1432,11 @@ generate_join_implied_equalities_normal(PlannerInfo *root,
 	 * as well as to at least one input member, plus enforce at least one
 	 * outer-rel member equal to at least one inner-rel member.
 	 */
-	foreach(lc1, ec->ec_members)
+	/** modification start **/
+	ec_member_iterator_begin(&it, ec, join_relids);
+	while ((cur_em = ec_member_iterator_next(&it)) != NULL)
 	{
-		EquivalenceMember *cur_em = (EquivalenceMember *) lfirst(lc1);
-
+		/** modification end **/
 		/*
 		 * We don't need to check explicitly for child EC members.  This test
 		 * against join_relids will cause them to be ignored except when
@@ -2624,7 +2675,10 @@ generate_implied_equalities_for_column(PlannerInfo *root,
 	{
 		EquivalenceClass *cur_ec = (EquivalenceClass *) list_nth(root->eq_classes, i);
 		EquivalenceMember *cur_em;
-		ListCell   *lc2;
+		/** modification start **/
+		EquivalenceMember *other_em;
+		ECMemberIterator it;
+		/** modification end **/
 
 		/* Sanity check eclass_indexes only contain ECs for rel */
 		Assert(is_child_rel || bms_is_subset(rel->relids, cur_ec->ec_relids));
@@ -2646,15 +2700,16 @@ generate_implied_equalities_for_column(PlannerInfo *root,
 		 * corner cases, so for now we live with just reporting the first
 		 * match.  See also get_eclass_for_sort_expr.)
 		 */
-		cur_em = NULL;
-		foreach(lc2, cur_ec->ec_members)
+		/** modification start **/
+		ec_member_iterator_begin(&it, cur_ec, rel->relids);
+		while ((cur_em = ec_member_iterator_next(&it)) != NULL)
 		{
-			cur_em = (EquivalenceMember *) lfirst(lc2);
 			if (bms_equal(cur_em->em_relids, rel->relids) &&
 				callback(root, rel, cur_ec, cur_em, callback_arg))
 				break;
-			cur_em = NULL;
 		}
+		ec_member_iterator_end(&it);
+		/** modification end **/
 
 		if (!cur_em)
 			continue;
@@ -2663,9 +2718,11 @@ generate_implied_equalities_for_column(PlannerInfo *root,
 		 * Found our match.  Scan the other EC members and attempt to generate
 		 * joinclauses.
 		 */
-		foreach(lc2, cur_ec->ec_members)
+		/** modification start **/
+		ec_member_iterator_begin(&it, cur_ec, NULL);
+		while ((other_em = ec_member_iterator_next(&it)) != NULL)
 		{
-			EquivalenceMember *other_em = (EquivalenceMember *) lfirst(lc2);
+			/** modification end **/
 			Oid			eq_op;
 			RestrictInfo *rinfo;
 
@@ -3002,3 +3059,189 @@ get_common_eclass_indexes(PlannerInfo *root, Relids relids1, Relids relids2)
 	/* Calculate and return the common EC indexes, recycling the left input. */
 	return bms_int_members(rel1ecs, rel2ecs);
 }
+
+/** modification start **/
+/*
+ * get_ec_member_index
+ *	  Returns the member index of the given EC, brought up to date with its
+ *	  ec_members, or NULL if the EC is too small to be worth indexing.
+ *
+ * ECs are allocated in the planner_cxt, so is their index.
+ */
+static ECMemberIndex *
+get_ec_member_index(EquivalenceClass *ec)
+{
+	ECMemberIndex *index;
+	MemoryContext oldcxt;
+	int			length = list_length(ec->ec_members);
+	bool		found;
+
+	if (length < EC_MEMBER_INDEX_MIN_MEMBERS)
+		return NULL;
+
+	/* The indexes of former planning cycles are gone with their contexts */
+	if (ec_member_indexes == NULL || ec_member_indexes_cycle != planning_cycle)
+	{
+		HASHCTL		hash_ctl;
+
+		MemSet(&hash_ctl, 0, sizeof(hash_ctl));
+		hash_ctl.keysize = sizeof(EquivalenceClass *);
+		hash_ctl.entrysize = sizeof(ECMemberIndex);
+		hash_ctl.hcxt = GetMemoryChunkContext(ec);
+		ec_member_indexes = hash_create("ECMemberIndexes",
+										64L,
+										&hash_ctl,
+										HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+		ec_member_indexes_cycle = planning_cycle;
+	}
+
+	index = (ECMemberIndex *) hash_search(ec_member_indexes, &ec,
+										  HASH_ENTER, &found);
+	if (!found ||
+		length < index->nindexed ||
+		(index->nindexed > 0 &&
+		 list_nth(ec->ec_members, index->nindexed - 1) != index->last_em))
+	{
+		index->nindexed = 0;
+		index->last_em = NULL;
+		index->parents = NULL;
+		index->nbuckets = 0;
+		index->children = NULL;
+	}
+
+	if (index->nindexed == length)
+		return index;
+
+	oldcxt = MemoryContextSwitchTo(GetMemoryChunkContext(ec));
+	while (index->nindexed < length)
+	{
+		EquivalenceMember *em = (EquivalenceMember *) list_nth(ec->ec_members,
+															   index->nindexed);
+
+		add_ec_member_index_entry(index, em, index->nindexed);
+		index->nindexed++;
+		index->last_em = em;
+	}
+	MemoryContextSwitchTo(oldcxt);
+
+	return index;
+}
+
+/*
+ * add_ec_member_index_entry
+ *	  Record the member at the given position of ec_members.
+ */
+static void
+add_ec_member_index_entry(ECMemberIndex *index, EquivalenceMember *em,
+						  int position)
+{
+	int			relid = -1;
+
+	if (!em->em_is_child)
+	{
+		index->parents = bms_add_member(index->parents, position);
+		return;
+	}
+
+	while ((relid = bms_next_member(em->em_relids, relid)) >= 0)
+	{
+		if (relid >= index->nbuckets)
+		{
+			int			nbuckets = Max(relid + 1, index->nbuckets * 2);
+
+			if (index->children == NULL)
+				index->children = (Bitmapset **)
+					palloc0(nbuckets * sizeof(Bitmapset *));
+			else
+			{
+				index->children = (Bitmapset **)
+					repalloc(index->children, nbuckets * sizeof(Bitmapset *));
+				MemSet(index->children + index->nbuckets, 0,
+					   (nbuckets - index->nbuckets) * sizeof(Bitmapset *));
+			}
+			index->nbuckets = nbuckets;
+		}
+		index->children[relid] = bms_add_member(index->children[relid],
+												position);
+	}
+}
+
+/*
+ * ec_member_iterator_begin
+ *	  Start iterating the members of an EC that may matter for the given
+ *	  relids: all non-child members, and the child members whose em_relids
+ *	  overlap relids.  The members come in ec_members order.
+ *
+ * This only narrows down the scan of ec_members; callers apply the same
+ * tests to the members as before.  Small ECs are scanned as a whole.
+ */
+void
+ec_member_iterator_begin(ECMemberIterator *it, EquivalenceClass *ec,
+						 Relids relids)
+{
+	ECMemberIndex *index = get_ec_member_index(ec);
+	int			relid = -1;
+
+	it->ec = ec;
+	it->position = -1;
+	it->indexed = (index != NULL);
+	it->positions = NULL;
+	it->owned = false;
+
+	if (index == NULL)
+		return;
+
+	it->positions = index->parents;
+	while ((relid = bms_next_member(relids, relid)) >= 0)
+	{
+		if (relid >= index->nbuckets || index->children[relid] == NULL)
+			continue;
+
+		if (!it->owned)
+		{
+			it->positions = bms_copy(it->positions);
+			it->owned = true;
+		}
+		it->positions = bms_add_members(it->positions, index->children[relid]);
+	}
+}
+
+/*
+ * ec_member_iterator_next
+ *	  Returns the next member, or NULL at the end.
+ */
+EquivalenceMember *
+ec_member_iterator_next(ECMemberIterator *it)
+{
+	if (it->position < -1)
+		return NULL;			/* already at the end */
+
+	if (it->indexed)
+		it->position = bms_next_member(it->positions, it->position);
+	else if (it->position + 1 < list_length(it->ec->ec_members))
+		it->position++;
+	else
+		it->position = -2;
+
+	if (it->position < 0)
+	{
+		ec_member_iterator_end(it);
+		return NULL;
+	}
+
+	return (EquivalenceMember *) list_nth(it->ec->ec_members, it->position);
+}
+
+/*
+ * ec_member_iterator_end
+ *	  Release the iterator, for callers that stop before the end.
+ */
+void
+ec_member_iterator_end(ECMemberIterator *it)
+{
+	if (it->owned)
+		bms_free(it->positions);
+	it->positions = NULL;
+	it->owned = false;
+}
+/** modification end **/
@@ -34,6 +34,12 @@
 #include "optimizer/restrictinfo.h"
 #include "utils/lsyscache.h"
 #include "utils/selfuncs.h"
+/** modification start **/
+#include "anchor2struct.h"
+#include "optimizer/pilotscope_paths.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+/** modification end **/
 
 
 /* XXX see PartCollMatchesExprColl */
@@ -73,6 +79,40 @@ typedef struct
 	int			indexcol;		/* index column we want to match to */
 } ec_member_matches_arg;
 
+/** modification start **/
+/*
+ * The attnos of the plain key columns of an index, offset by
+ * FirstLowInvalidHeapAttributeNumber as in pull_varattnos.  A clause can only
+ * match a plain key column if it mentions that column, so most pairs of
+ * clauses and indexes are rejected by a bitmap test.
+ */
+typedef struct IndexKeyAttnos
+{
+	IndexOptInfo *index;		/* hash key --- MUST BE FIRST */
+	Bitmapset  *key_attnos;		/* attnos of the plain key columns */
+	bool		has_expressions;	/* has expression key columns? */
+} IndexKeyAttnos;
+
+/* The attnos of the Vars of one rel in a clause */
+typedef struct ClauseAttnosKey
+{
+	RestrictInfo *rinfo;
+	Index		relid;
+} ClauseAttnosKey;
+
+typedef struct ClauseAttnosEntry
+{
+	ClauseAttnosKey key;		/* hash key --- MUST BE FIRST */
+	Bitmapset  *attnos;
+} ClauseAttnosEntry;
+
+/* Both memos are for the current planning cycle only */
+static HTAB *index_key_attnos_memo = NULL;
+static int	index_key_attnos_memo_cycle = 0;
+static HTAB *clause_attnos_memo = NULL;
+static int	clause_attnos_memo_cycle = 0;
+/** modification end **/
+
 
 static void consider_index_join_clauses(PlannerInfo *root, RelOptInfo *rel,
 										IndexOptInfo *index,
@@ -188,6 +228,11 @@ static Expr *match_clause_to_ordering_op(IndexOptInfo *index,
 static bool ec_member_matches_indexcol(PlannerInfo *root, RelOptInfo *rel,
 									   EquivalenceClass *ec, EquivalenceMember *em,
 									   void *arg);
+/** modification start **/
+static IndexKeyAttnos *get_index_key_attnos(IndexOptInfo *index);
+static Bitmapset *get_clause_attnos(PlannerInfo *root, RestrictInfo *rinfo,
+									Index relid);
+/** modification end **/
 
 
 /*
@@ -2170,6 +2215,10 @@ match_clause_to_index(PlannerInfo *root,
 					  IndexClauseSet *clauseset)
 {
 	int			indexcol;
+	/** modification start **/
+	IndexKeyAttnos *key_attnos;
+	Bitmapset  *clause_attnos;
+	/** modification end **/
 
 	/*
 	 * Never match pseudoconstants to indexes.  (Normally a match could not
@@ -2187,12 +2236,34 @@ match_clause_to_index(PlannerInfo *root,
 	if (!restriction_is_securely_promotable(rinfo, index->rel))
 		return;
 
+	/** modification start **/
+	/* Skip the index at once if the clause mentions none of its columns */
+	key_attnos = get_index_key_attnos(index);
+	clause_attnos = get_clause_attnos(root, rinfo, index->rel->relid);
+	if (!key_attnos->has_expressions &&
+		!bms_overlap(clause_attnos, key_attnos->key_attnos))
+		return;
+	/** modification end **/
+
 	/* OK, check each index key column for a match */
 	for (indexcol = 0; indexcol < index->nkeycolumns; indexcol++)
 	{
 		IndexClause *iclause;
 		ListCell   *lc;
 
+		/** modification start **/
+		/*
+		 * A plain key column can only match a clause that mentions it.  (If
+		 * the clause was matched to this column before, it mentions it, so
+		 * the duplicate check below is not skipped for it.)
+		 */
+		if (index->indexkeys[indexcol] != 0 &&
+			!bms_is_member(index->indexkeys[indexcol] -
+						   FirstLowInvalidHeapAttributeNumber,
+						   clause_attnos))
+			continue;
+		/** modification end **/
+
 		/* Ignore duplicates */
 		foreach(lc, clauseset->indexclauses[indexcol])
 		{
@@ -3810,3 +3881,126 @@ is_pseudo_constant_for_index(Node *expr, IndexOptInfo *index)
 		return false;			/* no good, volatile comparison value */
 	return true;
 }
+
+/** modification start **/
+/*
+ * register_index_key_attnos
+ *	  Compute the key attnos of an index while get_relation_info builds it.
+ *
+ * Indexes added later (e.g. hypothetical ones by get_relation_info_hook) are
+ * registered on their first lookup.
+ */
+void
+register_index_key_attnos(IndexOptInfo *index)
+{
+	(void) get_index_key_attnos(index);
+}
+
+/*
+ * get_index_key_attnos
+ *	  Returns the key attnos of an index, computing them on first use.
+ *
+ * IndexOptInfos live in the planner_cxt, so does their entry.
+ */
+static IndexKeyAttnos *
+get_index_key_attnos(IndexOptInfo *index)
+{
+	IndexKeyAttnos *entry;
+	bool		found;
+
+	if (index_key_attnos_memo == NULL ||
+		index_key_attnos_memo_cycle != planning_cycle)
+	{
+		HASHCTL		hash_ctl;
+
+		MemSet(&hash_ctl, 0, sizeof(hash_ctl));
+		hash_ctl.keysize = sizeof(IndexOptInfo *);
+		hash_ctl.entrysize = sizeof(IndexKeyAttnos);
+		hash_ctl.hcxt = GetMemoryChunkContext(index);
+		index_key_attnos_memo = hash_create("IndexKeyAttnos",
+											64L,
+											&hash_ctl,
+											HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+		index_key_attnos_memo_cycle = planning_cycle;
+	}
+
+	entry = (IndexKeyAttnos *) hash_search(index_key_attnos_memo, &index,
+										   HASH_ENTER, &found);
+	if (!found)
+	{
+		MemoryContext oldcxt = MemoryContextSwitchTo(GetMemoryChunkContext(index));
+		int			indexcol;
+
+		entry->key_attnos = NULL;
+		entry->has_expressions = false;
+		for (indexcol = 0; indexcol < index->nkeycolumns; indexcol++)
+		{
+			if (index->indexkeys[indexcol] == 0)
+				entry->has_expressions = true;
+			else
+				entry->key_attnos =
+					bms_add_member(entry->key_attnos,
+								   index->indexkeys[indexcol] -
+								   FirstLowInvalidHeapAttributeNumber);
+		}
+		MemoryContextSwitchTo(oldcxt);
+	}
+
+	return entry;
+}
+
+/*
+ * get_clause_attnos
+ *	  Returns the attnos of the Vars of the given rel in a clause, offset by
+ *	  FirstLowInvalidHeapAttributeNumber.
+ *
+ * The result is memoized when we run in the planner_cxt; clauses made in a
+ * scratch context are looked at directly.
+ */
+static Bitmapset *
+get_clause_attnos(PlannerInfo *root, RestrictInfo *rinfo, Index relid)
+{
+	ClauseAttnosKey key;
+	ClauseAttnosEntry *entry;
+	Bitmapset  *attnos = NULL;
+	bool		found;
+
+	if (!bms_is_member(relid, rinfo->clause_relids))
+		return NULL;
+
+	if (CurrentMemoryContext != root->planner_cxt)
+	{
+		pull_varattnos((Node *) rinfo->clause, relid, &attnos);
+		return attnos;
+	}
+
+	if (clause_attnos_memo == NULL ||
+		clause_attnos_memo_cycle != planning_cycle)
+	{
+		HASHCTL		hash_ctl;
+
+		MemSet(&hash_ctl, 0, sizeof(hash_ctl));
+		hash_ctl.keysize = sizeof(ClauseAttnosKey);
+		hash_ctl.entrysize = sizeof(ClauseAttnosEntry);
+		hash_ctl.hcxt = root->planner_cxt;
+		clause_attnos_memo = hash_create("ClauseAttnos",
+										 256L,
+										 &hash_ctl,
+										 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+		clause_attnos_memo_cycle = planning_cycle;
+	}
+
+	MemSet(&key, 0, sizeof(key));
+	key.rinfo = rinfo;
+	key.relid = relid;
+	entry = (ClauseAttnosEntry *) hash_search(clause_attnos_memo, &key,
+											  HASH_ENTER, &found);
+	if (!found)
+	{
+		entry->attnos = NULL;
+		pull_varattnos((Node *) rinfo->clause, relid, &entry->attnos);
+	}
+
+	return entry->attnos;
+}
+/** modification end **/
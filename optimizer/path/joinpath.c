@@ -22,10 +22,21 @@
 #include "optimizer/pathnode.h"
 #include "optimizer/paths.h"
 #include "optimizer/planmain.h"
+/** modification start **/
+#include "optimizer/pilotscope_paths.h"
+/** modification end **/
 
 /* Hook for plugins to get control in add_paths_to_joinrel() */
 set_join_pathlist_hook_type set_join_pathlist_hook = NULL;
 
+/** modification start **/
+/*
+ * The join methods add_paths_to_joinrel tries for non-full joins, see
+ * try_partitionwise_join.
+ */
+int			join_method_mask = JOIN_METHOD_ALL;
+/** modification end **/
+
 /*
  * Paths parameterized by the parent can be considered to be parameterized by
  * any of its child.
@@ -265,7 +276,10 @@ add_paths_to_joinrel(PlannerInfo *root,
 	 * 1. Consider mergejoin paths where both relations must be explicitly
 	 * sorted.  Skip this if we can't mergejoin.
 	 */
-	if (mergejoin_allowed)
+	/** modification start **/
+	if (mergejoin_allowed &&
+		((join_method_mask & JOIN_METHOD_MERGEJOIN) || jointype == JOIN_FULL))
+	/** modification end **/
 		sort_inner_and_outer(root, joinrel, outerrel, innerrel,
 							 jointype, &extra);
 
@@ -276,7 +290,11 @@ add_paths_to_joinrel(PlannerInfo *root,
 	 * (That's okay because we know that nestloop can't handle right/full
 	 * joins at all, so it wouldn't work in the prohibited cases either.)
 	 */
-	if (mergejoin_allowed)
+	/** modification start **/
+	if (mergejoin_allowed &&
+		((join_method_mask & (JOIN_METHOD_NESTLOOP | JOIN_METHOD_MERGEJOIN)) ||
+		 jointype == JOIN_FULL))
+	/** modification end **/
 		match_unsorted_outer(root, joinrel, outerrel, innerrel,
 							 jointype, &extra);
 
@@ -303,7 +321,10 @@ add_paths_to_joinrel(PlannerInfo *root,
 	 * before being joined.  As above, disregard enable_hashjoin for full
 	 * joins, because there may be no other alternative.
 	 */
-	if (enable_hashjoin || jointype == JOIN_FULL)
+	/** modification start **/
+	if ((enable_hashjoin && (join_method_mask & JOIN_METHOD_HASHJOIN)) ||
+		jointype == JOIN_FULL)
+	/** modification end **/
 		hash_inner_and_outer(root, joinrel, outerrel, innerrel,
 							 jointype, &extra);
 
@@ -22,6 +22,48 @@
 #include "partitioning/partbounds.h"
 #include "utils/memutils.h"
 
+/** modification start **/
+#include "optimizer/pilotscope_paths.h"
+#include "utils/hsearch.h"
+#include "utils/pilotscope_guc.h"
+
+/*
+ * A rel of a lower level, as seen by join_search_one_level_dpsize.
+ */
+typedef struct JoinLevelRel
+{
+	RelOptInfo *rel;
+	uint64		mask;			/* relids as a bitmask, if they fit */
+	bool		linked;			/* has join clauses or join restrictions */
+} JoinLevelRel;
+
+/*
+ * A candidate pair of join_search_one_level_dpsize.
+ */
+typedef struct JoinPairCandidate
+{
+	RelOptInfo *rel1;
+	RelOptInfo *rel2;
+	uint64		joinmask;		/* relids of the join rel, if they fit */
+	int			seq;			/* position in the order of discovery */
+} JoinPairCandidate;
+
+/*
+ * While not NULL, make_join_rel only builds the join rels of this root with
+ * their size estimates and adds no paths (see card_callback_join_level).
+ */
+PlannerInfo *join_rels_sizing_root = NULL;
+
+/*
+ * The join rels of the level of sized_join_rels_root that a sizing pass has
+ * built, but that the search of the level hasn't made again yet.  They are
+ * kept out of join_rel_level[] meanwhile, so that the search sees the level
+ * the same way as without a sizing pass.
+ */
+PlannerInfo *sized_join_rels_root = NULL;
+struct HTAB *sized_join_rels = NULL;
+/** modification end **/
+
 
 static void make_rels_by_clause_joins(PlannerInfo *root,
 									  RelOptInfo *old_rel,
@@ -53,6 +95,26 @@ static void get_matching_part_pairs(PlannerInfo *root, RelOptInfo *joinrel,
 									RelOptInfo *rel1, RelOptInfo *rel2,
 									List **parts1, List **parts2);
 
+/** modification start **/
+static void join_search_one_level_dpsize(PlannerInfo *root, int level);
+static JoinLevelRel *build_join_level_rels(PlannerInfo *root, List *rels,
+										   bool use_masks);
+static uint64 relids_to_mask(Relids relids);
+static int	join_pair_candidate_cmp(const void *a, const void *b);
+static bool is_similar_child_join(RelOptInfo *template_rel1,
+								  RelOptInfo *template_rel2,
+								  RelOptInfo *child_rel1,
+								  RelOptInfo *child_rel2);
+static int	get_join_methods_of_rel(RelOptInfo *joinrel);
+static void populate_child_joinrel_like_template(PlannerInfo *root,
+												 RelOptInfo *rel1,
+												 RelOptInfo *rel2,
+												 RelOptInfo *joinrel,
+												 SpecialJoinInfo *sjinfo,
+												 List *restrictlist,
+												 int methods);
+/** modification end **/
+
 
 /*
  * join_search_one_level
@@ -76,6 +138,14 @@ join_search_one_level(PlannerInfo *root, int level)
 
 	Assert(joinrels[level] == NIL);
 
+	/** modification start **/
+	if (join_enumerator == JOIN_ENUMERATOR_DPSIZE)
+	{
+		join_search_one_level_dpsize(root, level);
+		return;
+	}
+	/** modification end **/
+
 	/* Set join_cur_level so that new joinrels are added to proper list */
 	root->join_cur_level = level;
 
@@ -272,6 +342,232 @@ join_search_one_level(PlannerInfo *root, int level)
 	}
 }
 
+/** modification start **/
+/*
+ * join_search_one_level_dpsize
+ *	  The same level of the dynamic-programming search as join_search_one_level,
+ *	  split into a candidate phase and a build phase.
+ *
+ * The candidate phase considers exactly the pairs join_search_one_level would
+ * consider, but against a compact array of the lower-level rels whose relids
+ * are kept as 64-bit masks (when all relids are below 64) and whose "has join
+ * clauses or restrictions" test is done once per rel rather than once per pair.
+ * It only reads planner state.  The build phase then runs make_join_rel for
+ * the candidates grouped by the join rel they produce, so that all the paths
+ * of one join rel are added back to back, in an order that depends only on the
+ * relids and the order of discovery.
+ *
+ * The joinrels of one level are independent of each other, so the build phase
+ * is the natural place to spread the work over several cores.  We don't, since
+ * palloc, the syscaches and elog are not thread-safe inside a backend; the
+ * grouping is what such a split would work on.
+ */
+static void
+join_search_one_level_dpsize(PlannerInfo *root, int level)
+{
+	List	  **joinrels = root->join_rel_level;
+	bool		use_masks = (root->simple_rel_array_size <= 64);
+	JoinLevelRel **levelrels;
+	JoinPairCandidate *pairs;
+	int			npairs = 0;
+	int			maxpairs = 64;
+	int			k;
+	int			i;
+
+	/* Set join_cur_level so that new joinrels are added to proper list */
+	root->join_cur_level = level;
+
+	levelrels = (JoinLevelRel **) palloc0(level * sizeof(JoinLevelRel *));
+	for (k = 1; k < level; k++)
+		levelrels[k] = build_join_level_rels(root, joinrels[k], use_masks);
+
+	pairs = (JoinPairCandidate *) palloc(maxpairs * sizeof(JoinPairCandidate));
+
+#define add_join_pair_candidate(r1, r2) \
+	do { \
+		if (npairs >= maxpairs) \
+		{ \
+			maxpairs *= 2; \
+			pairs = (JoinPairCandidate *) repalloc(pairs, \
+								maxpairs * sizeof(JoinPairCandidate)); \
+		} \
+		pairs[npairs].rel1 = (r1)->rel; \
+		pairs[npairs].rel2 = (r2)->rel; \
+		pairs[npairs].joinmask = (r1)->mask | (r2)->mask; \
+		pairs[npairs].seq = npairs; \
+		npairs++; \
+	} while (0)
+
+#define join_level_rels_overlap(r1, r2) \
+	(use_masks ? ((r1)->mask & (r2)->mask) != 0 : \
+	 bms_overlap((r1)->rel->relids, (r2)->rel->relids))
+
+	/*
+	 * Candidate phase.  First the left-sided and right-sided plans, then the
+	 * bushy plans, with the same rules as join_search_one_level.
+	 */
+	for (i = 0; i < list_length(joinrels[level - 1]); i++)
+	{
+		JoinLevelRel *old_rel = &levelrels[level - 1][i];
+		int			j;
+
+		if (old_rel->linked)
+		{
+			/* at level 2 the condition is symmetric, see above */
+			for (j = (level == 2) ? i + 1 : 0; j < list_length(joinrels[1]); j++)
+			{
+				JoinLevelRel *other_rel = &levelrels[1][j];
+
+				if (!join_level_rels_overlap(old_rel, other_rel) &&
+					(have_relevant_joinclause(root, old_rel->rel, other_rel->rel) ||
+					 have_join_order_restriction(root, old_rel->rel, other_rel->rel)))
+					add_join_pair_candidate(old_rel, other_rel);
+			}
+		}
+		else
+		{
+			/* Cartesian product with each not-already-included initial rel */
+			for (j = 0; j < list_length(joinrels[1]); j++)
+			{
+				JoinLevelRel *other_rel = &levelrels[1][j];
+
+				if (!join_level_rels_overlap(old_rel, other_rel))
+					add_join_pair_candidate(old_rel, other_rel);
+			}
+		}
+	}
+
+	for (k = 2; k <= level - k; k++)
+	{
+		int			other_level = level - k;
+
+		for (i = 0; i < list_length(joinrels[k]); i++)
+		{
+			JoinLevelRel *old_rel = &levelrels[k][i];
+			int			j;
+
+			if (!old_rel->linked)
+				continue;
+
+			for (j = (k == other_level) ? i + 1 : 0;
+				 j < list_length(joinrels[other_level]); j++)
+			{
+				JoinLevelRel *new_rel = &levelrels[other_level][j];
+
+				if (!join_level_rels_overlap(old_rel, new_rel) &&
+					(have_relevant_joinclause(root, old_rel->rel, new_rel->rel) ||
+					 have_join_order_restriction(root, old_rel->rel, new_rel->rel)))
+					add_join_pair_candidate(old_rel, new_rel);
+			}
+		}
+	}
+
+#undef add_join_pair_candidate
+#undef join_level_rels_overlap
+
+	/*
+	 * Build phase.  Without masks we can't group cheaply, so the candidates
+	 * are built in the order of discovery, as join_search_one_level would.
+	 */
+	if (use_masks && npairs > 1)
+		qsort(pairs, npairs, sizeof(JoinPairCandidate), join_pair_candidate_cmp);
+
+	for (i = 0; i < npairs; i++)
+		(void) make_join_rel(root, pairs[i].rel1, pairs[i].rel2);
+
+	/*
+	 * Last-ditch effort, exactly as in join_search_one_level: force
+	 * cartesian-product joins if no usable joins were found.
+	 */
+	if (joinrels[level] == NIL)
+	{
+		ListCell   *r;
+
+		foreach(r, joinrels[level - 1])
+		{
+			RelOptInfo *old_rel = (RelOptInfo *) lfirst(r);
+
+			make_rels_by_clauseless_joins(root,
+										  old_rel,
+										  joinrels[1]);
+		}
+
+		if (joinrels[level] == NIL &&
+			root->join_info_list == NIL &&
+			!root->hasLateralRTEs)
+			elog(ERROR, "failed to build any %d-way joins", level);
+	}
+
+	for (k = 1; k < level; k++)
+		pfree(levelrels[k]);
+	pfree(levelrels);
+	pfree(pairs);
+}
+
+/*
+ * build_join_level_rels
+ *	  Build the compact array of one level for join_search_one_level_dpsize.
+ */
+static JoinLevelRel *
+build_join_level_rels(PlannerInfo *root, List *rels, bool use_masks)
+{
+	JoinLevelRel *result;
+	ListCell   *lc;
+	int			i = 0;
+
+	result = (JoinLevelRel *) palloc(Max(list_length(rels), 1) * sizeof(JoinLevelRel));
+	foreach(lc, rels)
+	{
+		RelOptInfo *rel = (RelOptInfo *) lfirst(lc);
+
+		result[i].rel = rel;
+		result[i].mask = use_masks ? relids_to_mask(rel->relids) : 0;
+		result[i].linked = (rel->joininfo != NIL || rel->has_eclass_joins ||
+							has_join_restriction(root, rel));
+		i++;
+	}
+
+	return result;
+}
+
+/*
+ * relids_to_mask
+ *	  Convert relids that are all below 64 into a bitmask.
+ */
+static uint64
+relids_to_mask(Relids relids)
+{
+	uint64		mask = 0;
+	int			relid = -1;
+
+	while ((relid = bms_next_member(relids, relid)) >= 0)
+	{
+		Assert(relid < 64);
+		mask |= UINT64CONST(1) << relid;
+	}
+
+	return mask;
+}
+
+/*
+ * join_pair_candidate_cmp
+ *	  qsort comparator grouping the candidates by join rel, keeping the order
+ *	  of discovery inside each group.
+ */
+static int
+join_pair_candidate_cmp(const void *a, const void *b)
+{
+	const JoinPairCandidate *pa = (const JoinPairCandidate *) a;
+	const JoinPairCandidate *pb = (const JoinPairCandidate *) b;
+
+	if (pa->joinmask != pb->joinmask)
+		return (pa->joinmask < pb->joinmask) ? -1 : 1;
+	if (pa->seq != pb->seq)
+		return (pa->seq < pb->seq) ? -1 : 1;
+	return 0;
+}
+/** modification end **/
+
 /*
  * make_rels_by_clause_joins
  *	  Build joins between the given relation 'old_rel' and other relations
@@ -746,6 +1042,29 @@ make_join_rel(PlannerInfo *root, RelOptInfo *rel1, RelOptInfo *rel2)
 	joinrel = build_join_rel(root, joinrelids, rel1, rel2, sjinfo,
 							 &restrictlist);
 
+	/** modification start **/
+	/* In a sizing pass, the paths are added when the level is searched */
+	if (root == join_rels_sizing_root)
+	{
+		bms_free(joinrelids);
+		return joinrel;
+	}
+
+	/*
+	 * build_join_rel only adds the rels it makes to join_rel_level[], so add
+	 * a rel of the sizing pass when the search makes it for the first time.
+	 */
+	if (root == sized_join_rels_root && sized_join_rels != NULL)
+	{
+		bool		found;
+
+		hash_search(sized_join_rels, &joinrel, HASH_REMOVE, &found);
+		if (found)
+			root->join_rel_level[root->join_cur_level] =
+				lappend(root->join_rel_level[root->join_cur_level], joinrel);
+	}
+	/** modification end **/
+
 	/*
 	 * If we've already proven this join is empty, we needn't consider any
 	 * more paths for it.
@@ -765,6 +1084,73 @@ make_join_rel(PlannerInfo *root, RelOptInfo *rel1, RelOptInfo *rel2)
 	return joinrel;
 }
 
+/** modification start **/
+/*
+ * make_join_rel_without_paths
+ *	   Find or create the join rel of rel1 and rel2 like make_join_rel, but
+ *	   only compute its size estimate and don't add any path to it.
+ *
+ * Returns NULL if the join is not legal.  Used to compare the sizes of
+ * candidate joins cheaply; a later make_join_rel for the same pair finds the
+ * rel and adds the paths.
+ */
+RelOptInfo *
+make_join_rel_without_paths(PlannerInfo *root, RelOptInfo *rel1,
+							RelOptInfo *rel2)
+{
+	Relids		joinrelids;
+	SpecialJoinInfo *sjinfo;
+	bool		reversed;
+	SpecialJoinInfo sjinfo_data;
+	RelOptInfo *joinrel;
+	List	   *restrictlist;
+
+	Assert(!bms_overlap(rel1->relids, rel2->relids));
+
+	joinrelids = bms_union(rel1->relids, rel2->relids);
+
+	if (!join_is_legal(root, rel1, rel2, joinrelids,
+					   &sjinfo, &reversed))
+	{
+		bms_free(joinrelids);
+		return NULL;
+	}
+
+	if (reversed)
+	{
+		RelOptInfo *trel = rel1;
+
+		rel1 = rel2;
+		rel2 = trel;
+	}
+
+	/* Make up a SpecialJoinInfo for a plain inner join, as make_join_rel */
+	if (sjinfo == NULL)
+	{
+		sjinfo = &sjinfo_data;
+		sjinfo->type = T_SpecialJoinInfo;
+		sjinfo->min_lefthand = rel1->relids;
+		sjinfo->min_righthand = rel2->relids;
+		sjinfo->syn_lefthand = rel1->relids;
+		sjinfo->syn_righthand = rel2->relids;
+		sjinfo->jointype = JOIN_INNER;
+		sjinfo->lhs_strict = false;
+		sjinfo->delay_upper_joins = false;
+		sjinfo->semi_can_btree = false;
+		sjinfo->semi_can_hash = false;
+		sjinfo->semi_operators = NIL;
+		sjinfo->semi_rhs_exprs = NIL;
+	}
+
+	joinrel = build_join_rel(root, joinrelids, rel1, rel2, sjinfo,
+							 &restrictlist);
+
+	bms_free(joinrelids);
+
+	return joinrel;
+}
+/** modification end **/
+
 /*
  * populate_joinrel_with_paths
  *	  Add paths to the given joinrel for given pair of joining relations. The
@@ -1366,6 +1752,11 @@ try_partitionwise_join(PlannerInfo *root, RelOptInfo *rel1, RelOptInfo *rel2,
 	ListCell   *lcr1 = NULL;
 	ListCell   *lcr2 = NULL;
 	int			cnt_parts;
+	/** modification start **/
+	RelOptInfo *template_rel1 = NULL;
+	RelOptInfo *template_rel2 = NULL;
+	int			template_methods = JOIN_METHOD_ALL;
+	/** modification end **/
 
 	/* Guard against stack overflow due to overly deep partition hierarchy. */
 	check_stack_depth();
@@ -1545,12 +1936,139 @@ try_partitionwise_join(PlannerInfo *root, RelOptInfo *rel1, RelOptInfo *rel2,
 
 		Assert(bms_equal(child_joinrel->relids, child_joinrelids));
 
+		/** modification start **/
+		if (enable_partitionwise_join_template &&
+			parent_sjinfo->jointype != JOIN_FULL)
+		{
+			if (template_rel1 != NULL &&
+				is_similar_child_join(template_rel1, template_rel2,
+									  child_rel1, child_rel2))
+			{
+				populate_child_joinrel_like_template(root, child_rel1,
+													 child_rel2,
+													 child_joinrel,
+													 child_sjinfo,
+													 child_restrictlist,
+													 template_methods);
+				continue;
+			}
+
+			populate_joinrel_with_paths(root, child_rel1, child_rel2,
+										child_joinrel, child_sjinfo,
+										child_restrictlist);
+			if (template_rel1 == NULL && !rel1_empty && !rel2_empty &&
+				!IS_DUMMY_REL(child_joinrel))
+			{
+				template_rel1 = child_rel1;
+				template_rel2 = child_rel2;
+				template_methods = get_join_methods_of_rel(child_joinrel);
+			}
+			continue;
+		}
+		/** modification end **/
+
 		populate_joinrel_with_paths(root, child_rel1, child_rel2,
 									child_joinrel, child_sjinfo,
 									child_restrictlist);
 	}
 }
 
+/** modification start **/
+/*
+ * is_similar_child_join
+ *	  Are the inputs of two child joins alike enough that the join methods
+ *	  that survived for one are worth trying alone for the other?
+ *
+ * Siblings of a partitionwise join have the same structure by construction,
+ * so we only compare the kinds of the inputs and their sizes.
+ */
+static bool
+is_similar_child_join(RelOptInfo *template_rel1, RelOptInfo *template_rel2,
+					  RelOptInfo *child_rel1, RelOptInfo *child_rel2)
+{
+	if (child_rel1->reloptkind != template_rel1->reloptkind ||
+		child_rel2->reloptkind != template_rel2->reloptkind)
+		return false;
+
+	if (IS_DUMMY_REL(child_rel1) || IS_DUMMY_REL(child_rel2))
+		return false;
+
+	return child_rel1->rows <= template_rel1->rows * 2 &&
+		child_rel1->rows * 2 >= template_rel1->rows &&
+		child_rel2->rows <= template_rel2->rows * 2 &&
+		child_rel2->rows * 2 >= template_rel2->rows;
+}
+
+/*
+ * get_join_methods_of_rel
+ *	  The join methods of the paths that survived in a join rel, as a mask of
+ *	  JOIN_METHOD_* bits; JOIN_METHOD_ALL if it has paths of another kind
+ *	  (e.g. foreign joins) or none.
+ */
+static int
+get_join_methods_of_rel(RelOptInfo *joinrel)
+{
+	int			methods = 0;
+	List	   *pathlists[2];
+	int			i;
+	ListCell   *lc;
+
+	pathlists[0] = joinrel->pathlist;
+	pathlists[1] = joinrel->partial_pathlist;
+	for (i = 0; i < 2; i++)
+	{
+		foreach(lc, pathlists[i])
+		{
+			Path	   *path = (Path *) lfirst(lc);
+
+			switch (nodeTag(path))
+			{
+				case T_NestPath:
+					methods |= JOIN_METHOD_NESTLOOP;
+					break;
+				case T_MergePath:
+					methods |= JOIN_METHOD_MERGEJOIN;
+					break;
+				case T_HashPath:
+					methods |= JOIN_METHOD_HASHJOIN;
+					break;
+				default:
+					return JOIN_METHOD_ALL;
+			}
+		}
+	}
+
+	return methods != 0 ? methods : JOIN_METHOD_ALL;
+}
+
+/*
+ * populate_child_joinrel_like_template
+ *	  populate_joinrel_with_paths for a child join, trying only the given join
+ *	  methods.
+ *
+ * If that leaves a child join without any path, we fall back to trying all
+ * of them.
+ */
+static void
+populate_child_joinrel_like_template(PlannerInfo *root, RelOptInfo *rel1,
+									 RelOptInfo *rel2, RelOptInfo *joinrel,
+									 SpecialJoinInfo *sjinfo,
+									 List *restrictlist, int methods)
+{
+	int			save_mask = join_method_mask;
+	bool		had_paths = (joinrel->pathlist != NIL);
+
+	join_method_mask = methods;
+	populate_joinrel_with_paths(root, rel1, rel2, joinrel, sjinfo,
+								restrictlist);
+	join_method_mask = save_mask;
+
+	if (!had_paths && joinrel->pathlist == NIL)
+		populate_joinrel_with_paths(root, rel1, rel2, joinrel, sjinfo,
+									restrictlist);
+}
+/** modification end **/
+
 /*
  * Construct the SpecialJoinInfo for a child-join by translating
  * SpecialJoinInfo for the join between parents. left_relids and right_relids
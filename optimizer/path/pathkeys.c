@@ -28,6 +28,58 @@
 #include "partitioning/partbounds.h"
 #include "utils/lsyscache.h"
 
+/** modification start **/
+#include "common/hashfn.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+#include "utils/pilotscope_guc.h"
+#include "anchor2struct.h"
+
+/*
+ * Registry of the canonical pathkeys of each PlannerInfo, so that
+ * make_canonical_pathkey needn't search root->canon_pathkeys.  An entry with
+ * a NULL eclass stands for the root itself and counts the pathkeys of
+ * root->canon_pathkeys already registered.
+ */
+typedef struct CanonPathKeyKey
+{
+	PlannerInfo *root;
+	EquivalenceClass *eclass;
+	Oid			opfamily;
+	int			strategy;
+	bool		nulls_first;
+} CanonPathKeyKey;
+
+typedef struct CanonPathKeyEntry
+{
+	CanonPathKeyKey key;		/* hash key --- MUST BE FIRST */
+	PathKey    *pathkey;
+	int			nregistered;	/* for the entry of the root only */
+} CanonPathKeyEntry;
+
+/*
+ * Interned pathkey lists: truncate_useless_pathkeys returns the same List
+ * for the same sequence of canonical pathkeys, so that compare_pathkeys can
+ * usually tell equal orderings apart by the pointers of the lists alone.
+ */
+typedef struct PathKeyListKey
+{
+	PlannerInfo *root;
+	uint32		hash;			/* hash of the pathkey pointers */
+} PathKeyListKey;
+
+typedef struct PathKeyListEntry
+{
+	PathKeyListKey key;			/* hash key --- MUST BE FIRST */
+	List	   *lists;			/* interned lists with this hash */
+} PathKeyListEntry;
+
+static HTAB *canon_pathkey_registry = NULL;
+static int	canon_pathkey_registry_cycle = 0;
+static HTAB *pathkey_list_registry = NULL;
+static int	pathkey_list_registry_cycle = 0;
+/** modification end **/
+
 
 static bool pathkey_is_redundant(PathKey *new_pathkey, List *pathkeys);
 static bool matches_boolean_partition_clause(RestrictInfo *rinfo,
@@ -35,6 +87,13 @@ static bool matches_boolean_partition_clause(RestrictInfo *rinfo,
 											 int partkeycol);
 static Var *find_var_for_subquery_tle(RelOptInfo *rel, TargetEntry *tle);
 static bool right_merge_direction(PlannerInfo *root, PathKey *pathkey);
+/** modification start **/
+static CanonPathKeyEntry *lookup_canonical_pathkey(PlannerInfo *root,
+												   EquivalenceClass *eclass,
+												   Oid opfamily, int strategy,
+												   bool nulls_first);
+static List *intern_pathkeys(PlannerInfo *root, List *pathkeys);
+/** modification end **/
 
 
 /****************************************************************************
@@ -58,6 +117,9 @@ make_canonical_pathkey(PlannerInfo *root,
 	PathKey    *pk;
 	ListCell   *lc;
 	MemoryContext oldcontext;
+	/** modification start **/
+	CanonPathKeyEntry *entry = NULL;
+	/** modification end **/
 
 	/* Can't make canonical pathkeys if the set of ECs might still change */
 	if (!root->ec_merging_done)
@@ -67,6 +129,16 @@ make_canonical_pathkey(PlannerInfo *root,
 	while (eclass->ec_merged)
 		eclass = eclass->ec_merged;
 
+	/** modification start **/
+	if (enable_pathkey_registry)
+	{
+		entry = lookup_canonical_pathkey(root, eclass, opfamily, strategy,
+										 nulls_first);
+		if (entry->pathkey != NULL)
+			return entry->pathkey;
+	}
+	else
+	/** modification end **/
 	foreach(lc, root->canon_pathkeys)
 	{
 		pk = (PathKey *) lfirst(lc);
@@ -93,6 +165,22 @@ make_canonical_pathkey(PlannerInfo *root,
 
 	MemoryContextSwitchTo(oldcontext);
 
+	/** modification start **/
+	if (entry != NULL)
+	{
+		CanonPathKeyKey rootkey;
+
+		entry->pathkey = pk;
+
+		/* Count it as registered, lookup_canonical_pathkey made the entry */
+		MemSet(&rootkey, 0, sizeof(rootkey));
+		rootkey.root = root;
+		entry = (CanonPathKeyEntry *) hash_search(canon_pathkey_registry,
+												  &rootkey, HASH_FIND, NULL);
+		entry->nregistered++;
+	}
+	/** modification end **/
+
 	return pk;
 }
 
@@ -1885,6 +1973,14 @@ truncate_useless_pathkeys(PlannerInfo *root,
 	 */
 	if (nuseful == 0)
 		return NIL;
+	/** modification start **/
+	else if (enable_pathkey_registry)
+	{
+		if (nuseful < list_length(pathkeys))
+			pathkeys = list_truncate(list_copy(pathkeys), nuseful);
+		return intern_pathkeys(root, pathkeys);
+	}
+	/** modification end **/
 	else if (nuseful == list_length(pathkeys))
 		return pathkeys;
 	else
@@ -1915,3 +2011,140 @@ has_useful_pathkeys(PlannerInfo *root, RelOptInfo *rel)
 		return true;			/* might be able to use them for ordering */
 	return false;				/* definitely useless */
 }
+
+/** modification start **/
+/*
+ * lookup_canonical_pathkey
+ *	  Find the registry entry of a canonical pathkey, making an empty one if
+ *	  there is no such pathkey yet.
+ *
+ * The registry is brought up to date with root->canon_pathkeys first, since
+ * it may have been filled before we were called.  The caller must fill in
+ * an empty entry and count it as registered, see make_canonical_pathkey.
+ */
+static CanonPathKeyEntry *
+lookup_canonical_pathkey(PlannerInfo *root, EquivalenceClass *eclass,
+						 Oid opfamily, int strategy, bool nulls_first)
+{
+	CanonPathKeyKey key;
+	CanonPathKeyEntry *rootentry;
+	CanonPathKeyEntry *entry;
+	bool		found;
+
+	/* The registries of former planning cycles are gone with their contexts */
+	if (canon_pathkey_registry == NULL ||
+		canon_pathkey_registry_cycle != planning_cycle)
+	{
+		HASHCTL		hash_ctl;
+
+		MemSet(&hash_ctl, 0, sizeof(hash_ctl));
+		hash_ctl.keysize = sizeof(CanonPathKeyKey);
+		hash_ctl.entrysize = sizeof(CanonPathKeyEntry);
+		hash_ctl.hcxt = root->planner_cxt;
+		canon_pathkey_registry = hash_create("CanonPathKeyRegistry",
+											 256L,
+											 &hash_ctl,
+											 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+		canon_pathkey_registry_cycle = planning_cycle;
+	}
+
+	/* Zero the padding, we hash the key bytes */
+	MemSet(&key, 0, sizeof(key));
+	key.root = root;
+	rootentry = (CanonPathKeyEntry *) hash_search(canon_pathkey_registry,
+												  &key, HASH_ENTER, &found);
+	if (!found)
+	{
+		rootentry->pathkey = NULL;
+		rootentry->nregistered = 0;
+	}
+
+	while (rootentry->nregistered < list_length(root->canon_pathkeys))
+	{
+		PathKey    *pk = (PathKey *) list_nth(root->canon_pathkeys,
+											  rootentry->nregistered);
+
+		key.eclass = pk->pk_eclass;
+		key.opfamily = pk->pk_opfamily;
+		key.strategy = pk->pk_strategy;
+		key.nulls_first = pk->pk_nulls_first;
+		entry = (CanonPathKeyEntry *) hash_search(canon_pathkey_registry,
+												  &key, HASH_ENTER, NULL);
+		entry->pathkey = pk;
+		rootentry->nregistered++;
+	}
+
+	key.eclass = eclass;
+	key.opfamily = opfamily;
+	key.strategy = strategy;
+	key.nulls_first = nulls_first;
+	entry = (CanonPathKeyEntry *) hash_search(canon_pathkey_registry,
+											  &key, HASH_ENTER, &found);
+	if (!found)
+		entry->pathkey = NULL;
+
+	return entry;
+}
+
+/*
+ * intern_pathkeys
+ *	  Return the interned List equal to the given list of canonical
+ *	  pathkeys, interning the given list itself if there is none.
+ *
+ * The lists are shared by the paths they are given to, so they must not be
+ * modified, which holds for pathkeys anyway.  We don't intern lists made in
+ * a GEQO temporary context, whose memory is recycled.
+ */
+static List *
+intern_pathkeys(PlannerInfo *root, List *pathkeys)
+{
+	PathKeyListKey key;
+	PathKeyListEntry *entry;
+	ListCell   *lc;
+	bool		found;
+
+	if (CurrentMemoryContext != root->planner_cxt ||
+		GetMemoryChunkContext(pathkeys) != root->planner_cxt)
+		return pathkeys;
+
+	if (pathkey_list_registry == NULL ||
+		pathkey_list_registry_cycle != planning_cycle)
+	{
+		HASHCTL		hash_ctl;
+
+		MemSet(&hash_ctl, 0, sizeof(hash_ctl));
+		hash_ctl.keysize = sizeof(PathKeyListKey);
+		hash_ctl.entrysize = sizeof(PathKeyListEntry);
+		hash_ctl.hcxt = root->planner_cxt;
+		pathkey_list_registry = hash_create("PathKeyListRegistry",
+											256L,
+											&hash_ctl,
+											HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+		pathkey_list_registry_cycle = planning_cycle;
+	}
+
+	MemSet(&key, 0, sizeof(key));
+	key.root = root;
+	foreach(lc, pathkeys)
+		key.hash = hash_combine(key.hash,
+								hash_bytes((const unsigned char *) &lfirst(lc),
+										   sizeof(void *)));
+
+	entry = (PathKeyListEntry *) hash_search(pathkey_list_registry,
+											 &key, HASH_ENTER, &found);
+	if (!found)
+		entry->lists = NIL;
+
+	foreach(lc, entry->lists)
+	{
+		List	   *interned = (List *) lfirst(lc);
+
+		if (compare_pathkeys(interned, pathkeys) == PATHKEYS_EQUAL)
+			return interned;
+	}
+
+	entry->lists = lappend(entry->lists, pathkeys);
+
+	return pathkeys;
+}
+/** modification end **/
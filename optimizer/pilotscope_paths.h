@@ -0,0 +1,64 @@
+/*-------------------------------------------------------------------------
+ *
+ * pilotscope_paths.h
+ *	  prototypes for the routines pilotscope adds to the optimizer.
+ *
+ * The optimizer files keep using the prototypes of the pg headers, such as
+ * "optimizer/paths.h". Only the routines that pilotscope adds and that are
+ * used across optimizer files are declared here.
+ *
+ * Copyright (c) 2023, Damo Academy of Alibaba Group
+ * 
+ *-------------------------------------------------------------------------
+ */
+#ifndef __PILOTSCOPE_PATHS__
+#define __PILOTSCOPE_PATHS__
+
+#include "nodes/pathnodes.h"
+
+/* allpaths.c */
+extern bool join_cost_exceeds_bound(RelOptInfo *rel, Cost total_cost,
+									List *pathkeys, Relids required_outer);
+
+/* costsize.c */
+extern void card_callback_base_rels(PlannerInfo *root);
+
+/* equivclass.c */
+typedef struct ECMemberIterator
+{
+	EquivalenceClass *ec;
+	bool		indexed;		/* iterating positions rather than the list */
+	bool		owned;			/* positions is our own copy */
+	Bitmapset  *positions;		/* positions of the members to visit */
+	int			position;		/* current position in ec_members */
+} ECMemberIterator;
+
+extern void ec_member_iterator_begin(ECMemberIterator *it,
+									 EquivalenceClass *ec, Relids relids);
+extern EquivalenceMember *ec_member_iterator_next(ECMemberIterator *it);
+extern void ec_member_iterator_end(ECMemberIterator *it);
+
+/* indxpath.c */
+extern void register_index_key_attnos(IndexOptInfo *index);
+
+/* joinpath.c */
+#define JOIN_METHOD_NESTLOOP	0x01
+#define JOIN_METHOD_MERGEJOIN	0x02
+#define JOIN_METHOD_HASHJOIN	0x04
+#define JOIN_METHOD_ALL			0x07
+
+extern int	join_method_mask;
+
+/* joinrels.c */
+extern PlannerInfo *join_rels_sizing_root;
+extern PlannerInfo *sized_join_rels_root;
+extern struct HTAB *sized_join_rels;
+
+extern RelOptInfo *make_join_rel_without_paths(PlannerInfo *root,
+											   RelOptInfo *rel1,
+											   RelOptInfo *rel2);
+
+/* relnode.c */
+extern void reset_join_rel_mask_table(PlannerInfo *root);
+
+#endif
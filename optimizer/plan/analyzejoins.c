@@ -32,6 +32,22 @@
 #include "optimizer/tlist.h"
 #include "utils/lsyscache.h"
 
+/** modification start **/
+#include "utils/pilotscope_guc.h"
+
+/*
+ * A uniqueness proof of join_is_removable: whether the inner rel is distinct
+ * for a set of join clauses, given its restriction clauses at the time.
+ */
+typedef struct DistinctnessProof
+{
+	Index		relid;
+	List	   *clause_list;	/* the join clauses, in any order */
+	int			nrestrictions;	/* length of the rel's baserestrictinfo */
+	bool		result;
+} DistinctnessProof;
+/** modification end **/
+
 /* local functions */
 static bool join_is_removable(PlannerInfo *root, SpecialJoinInfo *sjinfo);
 static void remove_rel_from_query(PlannerInfo *root, int relid,
@@ -47,6 +63,16 @@ static bool is_innerrel_unique_for(PlannerInfo *root,
 								   RelOptInfo *innerrel,
 								   JoinType jointype,
 								   List *restrictlist);
+/** modification start **/
+static List *remove_useless_joins_worklist(PlannerInfo *root, List *joinlist);
+static bool join_removal_depends_on_rel(PlannerInfo *root,
+										SpecialJoinInfo *sjinfo, int relid);
+static bool rel_is_distinct_for_cached(PlannerInfo *root, RelOptInfo *rel,
+									   List *clause_list);
+
+/* DistinctnessProofs of the current remove_useless_joins_worklist call */
+static List *distinctness_proofs = NIL;
+/** modification end **/
 
 
 /*
@@ -62,6 +88,11 @@ remove_useless_joins(PlannerInfo *root, List *joinlist)
 {
 	ListCell   *lc;
 
+	/** modification start **/
+	if (enable_join_removal_worklist)
+		return remove_useless_joins_worklist(root, joinlist);
+	/** modification end **/
+
 	/*
 	 * We are only interested in relations that are left-joined to, so we can
 	 * scan the join_info_list to find them easily.
@@ -287,6 +318,10 @@ join_is_removable(PlannerInfo *root, SpecialJoinInfo *sjinfo)
 	 * Now that we have the relevant equality join clauses, try to prove the
 	 * innerrel distinct.
 	 */
+	/** modification start **/
+	if (enable_join_removal_worklist)
+		return rel_is_distinct_for_cached(root, innerrel, clause_list);
+	/** modification end **/
 	if (rel_is_distinct_for(root, innerrel, clause_list))
 		return true;
 
@@ -1118,3 +1153,193 @@ is_innerrel_unique_for(PlannerInfo *root,
 	/* Let rel_is_distinct_for() do the hard work */
 	return rel_is_distinct_for(root, innerrel, clause_list);
 }
+
+/** modification start **/
+/*
+ * remove_useless_joins_worklist
+ *		remove_useless_joins without rechecking every join after a removal.
+ *
+ * remove_useless_joins restarts its scan of the join_info_list after each
+ * removal, so with many removable left joins most of the joins are checked
+ * over and over.  A join that failed join_is_removable can only start to
+ * pass if the removal of some rel changed the data it looked at, see
+ * join_removal_depends_on_rel, so we remember the failures and only check
+ * those joins again.  We still take the first removable join of the list
+ * each time, so the same joins are removed in the same order.  Uniqueness
+ * proofs are also remembered, see rel_is_distinct_for_cached.
+ */
+static List *
+remove_useless_joins_worklist(PlannerInfo *root, List *joinlist)
+{
+	int			njoins = list_length(root->join_info_list);
+	bool	   *failed;
+	ListCell   *lc;
+
+	if (njoins == 0)
+		return joinlist;
+
+	failed = (bool *) palloc0(njoins * sizeof(bool));
+	distinctness_proofs = NIL;
+
+restart:
+	foreach(lc, root->join_info_list)
+	{
+		SpecialJoinInfo *sjinfo = (SpecialJoinInfo *) lfirst(lc);
+		int			index = foreach_current_index(lc);
+		int			innerrelid;
+		int			nremoved;
+		ListCell   *lc2;
+
+		if (failed[index])
+			continue;
+
+		if (!join_is_removable(root, sjinfo))
+		{
+			failed[index] = true;
+			continue;
+		}
+
+		innerrelid = bms_singleton_member(sjinfo->min_righthand);
+
+		/* Check the failed joins again if the removal may change their fate */
+		foreach(lc2, root->join_info_list)
+		{
+			int			index2 = foreach_current_index(lc2);
+
+			if (failed[index2] &&
+				join_removal_depends_on_rel(root,
+											(SpecialJoinInfo *) lfirst(lc2),
+											innerrelid))
+				failed[index2] = false;
+		}
+
+		remove_rel_from_query(root, innerrelid,
+							  bms_union(sjinfo->min_lefthand,
+										sjinfo->min_righthand));
+
+		nremoved = 0;
+		joinlist = remove_rel_from_joinlist(joinlist, innerrelid, &nremoved);
+		if (nremoved != 1)
+			elog(ERROR, "failed to find relation %d in joinlist", innerrelid);
+
+		root->join_info_list = list_delete_cell(root->join_info_list, lc);
+		memmove(&failed[index], &failed[index + 1],
+				(njoins - index - 1) * sizeof(bool));
+		njoins--;
+
+		goto restart;
+	}
+
+	pfree(failed);
+	distinctness_proofs = NIL;
+
+	return joinlist;
+}
+
+/*
+ * join_removal_depends_on_rel
+ *		Could removing the given rel let join_is_removable pass for a join it
+ *		has failed?
+ *
+ * remove_rel_from_query deletes the rel from the attr_needed sets, the join
+ * relid sets and the placeholders, and moves the join clauses that required
+ * it.  Only the joins whose inner rel looks at some of that data can be
+ * affected.  Anything not checked here, such as the rel kind and its
+ * indexes, doesn't change.  This must be called before the removal.
+ */
+static bool
+join_removal_depends_on_rel(PlannerInfo *root, SpecialJoinInfo *sjinfo,
+							int relid)
+{
+	RelOptInfo *innerrel;
+	int			innerrelid;
+	int			attroff;
+	ListCell   *lc;
+
+	if (bms_is_member(relid, sjinfo->min_lefthand) ||
+		bms_is_member(relid, sjinfo->min_righthand))
+		return true;
+
+	/* join_is_removable can't get past these whatever we remove */
+	if (sjinfo->jointype != JOIN_LEFT ||
+		sjinfo->delay_upper_joins ||
+		!bms_get_singleton_member(sjinfo->min_righthand, &innerrelid))
+		return false;
+
+	innerrel = find_base_rel(root, innerrelid);
+
+	for (attroff = innerrel->max_attr - innerrel->min_attr;
+		 attroff >= 0;
+		 attroff--)
+	{
+		if (bms_is_member(relid, innerrel->attr_needed[attroff]))
+			return true;
+	}
+
+	foreach(lc, innerrel->joininfo)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+
+		if (bms_is_member(relid, rinfo->required_relids) ||
+			bms_is_member(relid, rinfo->clause_relids))
+			return true;
+	}
+
+	foreach(lc, root->placeholder_list)
+	{
+		PlaceHolderInfo *phinfo = (PlaceHolderInfo *) lfirst(lc);
+
+		if (bms_is_member(relid, phinfo->ph_eval_at) ||
+			bms_is_member(relid, phinfo->ph_needed))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * rel_is_distinct_for_cached
+ *		rel_is_distinct_for, remembering the proofs of the current
+ *		remove_useless_joins_worklist call.
+ *
+ * The answer depends on nothing but the rel, the set of join clauses and
+ * the restriction clauses of the rel, which can only be added to while we
+ * remove joins.
+ */
+static bool
+rel_is_distinct_for_cached(PlannerInfo *root, RelOptInfo *rel,
+						   List *clause_list)
+{
+	DistinctnessProof *proof;
+	int			nrestrictions = list_length(rel->baserestrictinfo);
+	ListCell   *lc;
+
+	foreach(lc, distinctness_proofs)
+	{
+		ListCell   *lc2;
+
+		proof = (DistinctnessProof *) lfirst(lc);
+		if (proof->relid != rel->relid ||
+			proof->nrestrictions != nrestrictions ||
+			list_length(proof->clause_list) != list_length(clause_list))
+			continue;
+
+		foreach(lc2, clause_list)
+		{
+			if (!list_member_ptr(proof->clause_list, lfirst(lc2)))
+				break;
+		}
+		if (lc2 == NULL)
+			return proof->result;
+	}
+
+	proof = (DistinctnessProof *) palloc(sizeof(DistinctnessProof));
+	proof->relid = rel->relid;
+	proof->clause_list = list_copy(clause_list);
+	proof->nrestrictions = nrestrictions;
+	proof->result = rel_is_distinct_for(root, rel, clause_list);
+	distinctness_proofs = lappend(distinctness_proofs, proof);
+
+	return proof->result;
+}
+/** modification end **/
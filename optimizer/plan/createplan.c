@@ -41,6 +41,9 @@
 #include "parser/parsetree.h"
 #include "partitioning/partprune.h"
 #include "utils/lsyscache.h"
+/** modification start **/
+#include "optimizer/pilotscope_paths.h"
+/** modification end **/
 
 
 /*
@@ -5966,10 +5969,13 @@ prepare_sort_from_pathkeys(Plan *lefttree, List *pathkeys,
 			 * WindowFunc in a sort expression, treat it as a variable.
 			 */
 			Expr	   *sortexpr = NULL;
+			/** modification start **/
+			ECMemberIterator it;
 
-			foreach(j, ec->ec_members)
+			ec_member_iterator_begin(&it, ec, relids);
+			while ((em = ec_member_iterator_next(&it)) != NULL)
 			{
-				EquivalenceMember *em = (EquivalenceMember *) lfirst(j);
+				/** modification end **/
 				List	   *exprvars;
 				ListCell   *k;
 
@@ -6006,8 +6012,11 @@ prepare_sort_from_pathkeys(Plan *lefttree, List *pathkeys,
 					break;		/* found usable expression */
 				}
 			}
-			if (!j)
+			/** modification start **/
+			ec_member_iterator_end(&it);
+			if (em == NULL)
 				elog(ERROR, "could not find pathkey item to sort");
+			/** modification end **/
 
 			/*
 			 * Do we need to insert a Result node?
@@ -6078,16 +6087,21 @@ find_ec_member_for_tle(EquivalenceClass *ec,
 					   Relids relids)
 {
 	Expr	   *tlexpr;
-	ListCell   *lc;
+	/** modification start **/
+	ECMemberIterator it;
+	EquivalenceMember *em;
+	/** modification end **/
 
 	/* We ignore binary-compatible relabeling on both ends */
 	tlexpr = tle->expr;
 	while (tlexpr && IsA(tlexpr, RelabelType))
 		tlexpr = ((RelabelType *) tlexpr)->arg;
 
-	foreach(lc, ec->ec_members)
+	/** modification start **/
+	ec_member_iterator_begin(&it, ec, relids);
+	while ((em = ec_member_iterator_next(&it)) != NULL)
 	{
-		EquivalenceMember *em = (EquivalenceMember *) lfirst(lc);
+		/** modification end **/
 		Expr	   *emexpr;
 
 		/*
@@ -6110,7 +6124,12 @@ find_ec_member_for_tle(EquivalenceClass *ec,
 			emexpr = ((RelabelType *) emexpr)->arg;
 
 		if (equal(emexpr, tlexpr))
+		{
+			/** modification start **/
+			ec_member_iterator_end(&it);
+			/** modification end **/
 			return em;
+		}
 	}
 
 	return NULL;
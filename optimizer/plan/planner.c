@@ -65,6 +65,11 @@
 #include "utils/selfuncs.h"
 #include "utils/syscache.h"
 
+/** modification start **/
+#include "anchor2struct.h"
+#include "optimizer/pilotscope_paths.h"
+/** modification end **/
+
 /* GUC parameters */
 double		cursor_tuple_fraction = DEFAULT_CURSOR_TUPLE_FRACTION;
 int			force_parallel_mode = FORCE_PARALLEL_OFF;
@@ -290,6 +295,13 @@ pilotscope_standard_planner(Query *parse, const char *query_string, int cursorOp
 	Plan	   *top_plan;
 	ListCell   *lp,
 			   *lr;
+
+	/** modification start **/
+	/* start a new cycle for the per-planning memos of pilotscope */
+	planning_cycle++;
+	/* an error may have left a restriction of the join methods behind */
+	join_method_mask = JOIN_METHOD_ALL;
+	/** modification end **/
     
 	/*
 	 * Set up global state for this planner invocation.  This data is needed
@@ -562,6 +574,16 @@ pilotscope_standard_planner(Query *parse, const char *query_string, int cursorOp
 	if (glob->partition_directory != NULL)
 		DestroyPartitionDirectory(glob->partition_directory);
 
+	/** modification start **/
+	/*
+	 * Start another cycle on the way out as well.  If we were called while
+	 * planning another query, e.g. by a function evaluated during its
+	 * planning, our memos live in contexts that are about to go away, and
+	 * the outer planning must not take them for its own.
+	 */
+	planning_cycle++;
+	/** modification end **/
+
 	return result;
 }
 
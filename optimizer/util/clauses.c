@@ -53,6 +53,16 @@
 #include "utils/syscache.h"
 #include "utils/typcache.h"
 
+/** modification start **/
+#include "catalog/namespace.h"
+#include "common/hashfn.h"
+#include "parser/parse_expr.h"
+#include "parser/parser.h"
+#include "utils/hsearch.h"
+#include "utils/inval.h"
+#include "utils/pilotscope_guc.h"
+/** modification end **/
+
 
 typedef struct
 {
@@ -97,6 +107,66 @@ typedef struct
 	List	   *safe_param_ids; /* PARAM_EXEC Param IDs to treat as safe */
 } max_parallel_hazard_context;
 
+/** modification start **/
+/*
+ * Backend-level caches of eval_const_expressions, used while
+ * pilotscope.enable_const_folding_cache is on.  Both are dropped whenever a
+ * function, operator, type, cast or schema changes, see
+ * invalidate_const_folding_caches.
+ *
+ * The inline function cache keeps the parsed and checked body of each SQL
+ * function inline_function has looked at, with Params in place of the
+ * arguments, or NULL if the body can't be inlined.  The body depends on the
+ * argument types (for polymorphic functions), the search_path and the
+ * settings that change how the body is parsed besides the function itself.
+ */
+typedef struct InlineFunctionKey
+{
+	Oid			funcid;
+	Oid			result_type;
+	Oid			input_collid;
+	bool		funcvariadic;
+	bool		standard_conforming_strings;
+	bool		transform_null_equals;
+	int			backslash_quote;
+	int			nargs;
+	Oid			argtypes[FUNC_MAX_ARGS];
+} InlineFunctionKey;
+
+typedef struct InlineFunctionEntry
+{
+	InlineFunctionKey key;		/* hash key --- MUST BE FIRST */
+	OverrideSearchPath *search_path;	/* search_path the body was parsed in */
+	Node	   *body;			/* the tlist expression, or NULL */
+} InlineFunctionEntry;
+
+/*
+ * The folded function cache keeps the results of immutable functions that
+ * evaluate_function has called with constant arguments.
+ */
+typedef struct FoldedFunctionCall
+{
+	FuncExpr   *expr;			/* the call, with Consts for arguments */
+	int32		result_typmod;
+	Const	   *result;
+} FoldedFunctionCall;
+
+typedef struct FoldedFunctionEntry
+{
+	uint32		hash;			/* hash key --- MUST BE FIRST */
+	List	   *calls;			/* FoldedFunctionCalls with this hash */
+} FoldedFunctionEntry;
+
+/* Stop remembering folded calls beyond this many */
+#define MAX_FOLDED_FUNCTION_CALLS	4096
+
+static MemoryContext const_folding_cxt = NULL;
+static HTAB *inline_function_cache = NULL;
+static HTAB *folded_function_cache = NULL;
+static int	num_folded_function_calls = 0;
+static uint64 const_folding_cache_generation = 0;
+/** modification end **/
+
 static bool contain_agg_clause_walker(Node *node, void *context);
 static bool get_agg_clause_costs_walker(Node *node,
 										get_agg_clause_costs_context *context);
@@ -157,6 +227,21 @@ static Query *substitute_actual_srf_parameters(Query *expr,
 static Node *substitute_actual_srf_parameters_mutator(Node *node,
 													  substitute_actual_srf_parameters_context *context);
 
+/** modification start **/
+static void init_const_folding_caches(void);
+static void invalidate_const_folding_caches(Datum arg, int cacheid,
+											uint32 hashvalue);
+static void make_inline_function_key(InlineFunctionKey *key, Oid funcid,
+									 Oid result_type, Oid input_collid,
+									 List *args, bool funcvariadic);
+static bool lookup_inline_function_body(InlineFunctionKey *key, Node **body);
+static void store_inline_function_body(InlineFunctionKey *key, Node *body,
+									   uint64 generation);
+static Expr *evaluate_immutable_function(FuncExpr *expr, Oid result_type,
+										 int32 result_typmod,
+										 Oid result_collid);
+/** modification end **/
+
 
 /*****************************************************************************
  *		Aggregate-function clause manipulation
@@ -4320,6 +4405,19 @@ evaluate_function(Oid funcid, Oid result_type, int32 result_typmod,
 	newexpr->args = args;
 	newexpr->location = -1;
 
+	/** modification start **/
+	/*
+	 * A cached result skips the checks ExecInitFunc makes on each call, so
+	 * only use the cache when they would pass anyway.
+	 */
+	if (enable_const_folding_cache &&
+		funcform->provolatile == PROVOLATILE_IMMUTABLE &&
+		pg_proc_aclcheck(funcid, GetUserId(), ACL_EXECUTE) == ACLCHECK_OK &&
+		!FmgrHookIsNeeded(funcid))
+		return evaluate_immutable_function(newexpr, result_type, result_typmod,
+										   result_collid);
+	/** modification end **/
+
 	return evaluate_expr((Expr *) newexpr, result_type, result_typmod,
 						 result_collid);
 }
@@ -4381,6 +4479,11 @@ inline_function(Oid funcid, Oid result_type, Oid result_collid,
 	int		   *usecounts;
 	ListCell   *arg;
 	int			i;
+	/** modification start **/
+	InlineFunctionKey cache_key;
+	bool		remember_body = false;
+	uint64		cache_generation = 0;
+	/** modification end **/
 
 	/*
 	 * Forget it if the function is not SQL-language or has other showstopper
@@ -4437,6 +4540,23 @@ inline_function(Oid funcid, Oid result_type, Oid result_collid,
 	sqlerrcontext.previous = error_context_stack;
 	error_context_stack = &sqlerrcontext;
 
+	/** modification start **/
+	/* Skip the parsing and checks of the body if we have been here before */
+	if (enable_const_folding_cache)
+	{
+		make_inline_function_key(&cache_key, funcid, result_type,
+								 input_collid, args, funcvariadic);
+		if (lookup_inline_function_body(&cache_key, &newexpr))
+		{
+			if (newexpr == NULL)
+				goto fail;
+			goto substitute;
+		}
+		remember_body = true;
+		cache_generation = const_folding_cache_generation;
+	}
+	/** modification end **/
+
 	/*
 	 * Set up to handle parameters while parsing the function body.  We need a
 	 * dummy FuncExpr node containing the already-simplified arguments to pass
@@ -4567,6 +4687,17 @@ inline_function(Oid funcid, Oid result_type, Oid result_collid,
 		contain_nonstrict_functions(newexpr))
 		goto fail;
 
+	/** modification start **/
+	/* Nothing above depends on the arguments but their types */
+	if (remember_body)
+	{
+		store_inline_function_body(&cache_key, newexpr, cache_generation);
+		remember_body = false;
+	}
+
+substitute:
+	/** modification end **/
+
 	/*
 	 * If any parameter expression contains a context-dependent node, we can't
 	 * inline, for fear of putting such a node into the wrong context.
@@ -4677,6 +4808,10 @@ inline_function(Oid funcid, Oid result_type, Oid result_collid,
 
 	/* Here if func is not inlinable: release temp memory and return NULL */
 fail:
+	/** modification start **/
+	if (remember_body)
+		store_inline_function_body(&cache_key, NULL, cache_generation);
+	/** modification end **/
 	MemoryContextSwitchTo(oldcxt);
 	MemoryContextDelete(mycxt);
 	error_context_stack = sqlerrcontext.previous;
@@ -5158,3 +5293,261 @@ substitute_actual_srf_parameters_mutator(Node *node,
 								   substitute_actual_srf_parameters_mutator,
 								   (void *) context);
 }
+
+/** modification start **/
+/*
+ * init_const_folding_caches
+ *	  Set up the caches of eval_const_expressions, if they aren't already.
+ */
+static void
+init_const_folding_caches(void)
+{
+	HASHCTL		hash_ctl;
+
+	if (const_folding_cxt == NULL)
+	{
+		const_folding_cxt = AllocSetContextCreate(CacheMemoryContext,
+												  "ConstFoldingCache",
+												  ALLOCSET_DEFAULT_SIZES);
+		CacheRegisterSyscacheCallback(PROCOID,
+									  invalidate_const_folding_caches,
+									  (Datum) 0);
+		CacheRegisterSyscacheCallback(OPEROID,
+									  invalidate_const_folding_caches,
+									  (Datum) 0);
+		CacheRegisterSyscacheCallback(TYPEOID,
+									  invalidate_const_folding_caches,
+									  (Datum) 0);
+		CacheRegisterSyscacheCallback(CASTSOURCETARGET,
+									  invalidate_const_folding_caches,
+									  (Datum) 0);
+		CacheRegisterSyscacheCallback(NAMESPACEOID,
+									  invalidate_const_folding_caches,
+									  (Datum) 0);
+	}
+
+	if (inline_function_cache == NULL)
+	{
+		MemSet(&hash_ctl, 0, sizeof(hash_ctl));
+		hash_ctl.keysize = sizeof(InlineFunctionKey);
+		hash_ctl.entrysize = sizeof(InlineFunctionEntry);
+		hash_ctl.hcxt = const_folding_cxt;
+		inline_function_cache = hash_create("InlineFunctionCache",
+											64L,
+											&hash_ctl,
+											HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
+
+	if (folded_function_cache == NULL)
+	{
+		MemSet(&hash_ctl, 0, sizeof(hash_ctl));
+		hash_ctl.keysize = sizeof(uint32);
+		hash_ctl.entrysize = sizeof(FoldedFunctionEntry);
+		hash_ctl.hcxt = const_folding_cxt;
+		folded_function_cache = hash_create("FoldedFunctionCache",
+											256L,
+											&hash_ctl,
+											HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+		num_folded_function_calls = 0;
+	}
+}
+
+/*
+ * invalidate_const_folding_caches
+ *	  Syscache callback dropping everything the caches hold.
+ *
+ * A cached body may depend on any function, operator, type or cast it
+ * resolved to, so we don't try to be smarter.  The generation counter lets
+ * a caller that was working out an entry while we ran know not to store it.
+ */
+static void
+invalidate_const_folding_caches(Datum arg, int cacheid, uint32 hashvalue)
+{
+	if (const_folding_cxt != NULL)
+		MemoryContextReset(const_folding_cxt);
+	inline_function_cache = NULL;
+	folded_function_cache = NULL;
+	num_folded_function_calls = 0;
+	const_folding_cache_generation++;
+}
+
+/*
+ * make_inline_function_key
+ *	  Build the key of the inline function cache for a call.
+ */
+static void
+make_inline_function_key(InlineFunctionKey *key, Oid funcid,
+						 Oid result_type, Oid input_collid,
+						 List *args, bool funcvariadic)
+{
+	ListCell   *lc;
+	int			i = 0;
+
+	/* Zero the padding and unused argument types, we hash the key bytes */
+	MemSet(key, 0, sizeof(InlineFunctionKey));
+	key->funcid = funcid;
+	key->result_type = result_type;
+	key->input_collid = input_collid;
+	key->funcvariadic = funcvariadic;
+	key->standard_conforming_strings = standard_conforming_strings;
+	key->transform_null_equals = Transform_null_equals;
+	key->backslash_quote = backslash_quote;
+	key->nargs = list_length(args);
+	foreach(lc, args)
+		key->argtypes[i++] = exprType((Node *) lfirst(lc));
+}
+
+/*
+ * lookup_inline_function_body
+ *	  Look for the body of a SQL function in the inline function cache.
+ *
+ * Returns true if found, setting *body to a copy of the body in the current
+ * memory context, or to NULL if the function can't be inlined.
+ */
+static bool
+lookup_inline_function_body(InlineFunctionKey *key, Node **body)
+{
+	InlineFunctionEntry *entry;
+	OverrideSearchPath *search_path;
+
+	if (inline_function_cache == NULL)
+		return false;
+
+	entry = (InlineFunctionEntry *) hash_search(inline_function_cache,
+												key,
+												HASH_FIND,
+												NULL);
+	if (entry == NULL)
+		return false;
+
+	/*
+	 * Take copies before checking the search_path, which may read catalogs
+	 * and so run invalidate_const_folding_caches.
+	 */
+	search_path = CopyOverrideSearchPath(entry->search_path);
+	*body = copyObject(entry->body);
+
+	return OverrideSearchPathMatchesCurrent(search_path);
+}
+
+/*
+ * store_inline_function_body
+ *	  Remember the body of a SQL function, or NULL if it can't be inlined.
+ *
+ * Nothing is stored if the caches were invalidated since the caller read
+ * the generation counter, as the body may have been parsed from stale
+ * catalog entries.
+ */
+static void
+store_inline_function_body(InlineFunctionKey *key, Node *body,
+						   uint64 generation)
+{
+	InlineFunctionEntry *entry;
+	OverrideSearchPath *search_path;
+	MemoryContext oldcxt;
+
+	/* This may read catalogs, so do it before checking the generation */
+	search_path = GetOverrideSearchPath(CurrentMemoryContext);
+
+	if (generation != const_folding_cache_generation)
+		return;
+
+	init_const_folding_caches();
+
+	entry = (InlineFunctionEntry *) hash_search(inline_function_cache,
+												key,
+												HASH_ENTER,
+												NULL);
+	oldcxt = MemoryContextSwitchTo(const_folding_cxt);
+	entry->search_path = CopyOverrideSearchPath(search_path);
+	entry->body = copyObject(body);
+	MemoryContextSwitchTo(oldcxt);
+}
+
+/*
+ * evaluate_immutable_function
+ *	  evaluate_expr for a call of an immutable function with constant
+ *	  arguments, looking the result up in the folded function cache first.
+ */
+static Expr *
+evaluate_immutable_function(FuncExpr *expr, Oid result_type,
+							int32 result_typmod, Oid result_collid)
+{
+	FoldedFunctionEntry *entry;
+	FoldedFunctionCall *call;
+	MemoryContext oldcxt;
+	Expr	   *result;
+	uint64		generation;
+	uint32		hash;
+	bool		found;
+	ListCell   *lc;
+
+	hash = hash_combine((uint32) expr->funcid, (uint32) result_type);
+	hash = hash_combine(hash, (uint32) result_typmod);
+	hash = hash_combine(hash, (uint32) result_collid);
+	hash = hash_combine(hash, (uint32) expr->inputcollid);
+	foreach(lc, expr->args)
+	{
+		Const	   *arg = lfirst_node(Const, lc);
+
+		hash = hash_combine(hash, (uint32) arg->consttype);
+		if (arg->constisnull)
+			hash = hash_combine(hash, 0);
+		else if (arg->constbyval)
+			hash = hash_combine(hash,
+								DatumGetUInt32(hash_any((unsigned char *) &arg->constvalue,
+														sizeof(Datum))));
+		else
+			hash = hash_combine(hash,
+								DatumGetUInt32(hash_any((unsigned char *) DatumGetPointer(arg->constvalue),
+														datumGetSize(arg->constvalue,
+																	 false,
+																	 arg->constlen))));
+	}
+
+	if (folded_function_cache != NULL)
+	{
+		entry = (FoldedFunctionEntry *) hash_search(folded_function_cache,
+													&hash,
+													HASH_FIND,
+													NULL);
+		if (entry != NULL)
+		{
+			foreach(lc, entry->calls)
+			{
+				call = (FoldedFunctionCall *) lfirst(lc);
+				if (call->result_typmod == result_typmod &&
+					equal(call->expr, expr))
+					return (Expr *) copyObject(call->result);
+			}
+		}
+	}
+
+	generation = const_folding_cache_generation;
+	result = evaluate_expr((Expr *) expr, result_type, result_typmod,
+						   result_collid);
+
+	if (generation != const_folding_cache_generation ||
+		num_folded_function_calls >= MAX_FOLDED_FUNCTION_CALLS)
+		return result;
+
+	init_const_folding_caches();
+
+	entry = (FoldedFunctionEntry *) hash_search(folded_function_cache,
+												&hash,
+												HASH_ENTER,
+												&found);
+	if (!found)
+		entry->calls = NIL;
+	oldcxt = MemoryContextSwitchTo(const_folding_cxt);
+	call = (FoldedFunctionCall *) palloc(sizeof(FoldedFunctionCall));
+	call->expr = copyObject(expr);
+	call->result_typmod = result_typmod;
+	call->result = (Const *) copyObject(result);
+	entry->calls = lappend(entry->calls, call);
+	num_folded_function_calls++;
+	MemoryContextSwitchTo(oldcxt);
+
+	return result;
+}
+/** modification end **/
@@ -34,6 +34,13 @@
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/selfuncs.h"
+/** modification start **/
+#include "optimizer/pilotscope_paths.h"
+#include "utils/hsearch.h"
+#include "utils/pilotscope_guc.h"
+#include "utils/cost_provider.h"
+#include "anchor2struct.h"
+/** modification end **/
 
 typedef enum
 {
@@ -57,6 +64,52 @@ static List *reparameterize_pathlist_by_child(PlannerInfo *root,
 											  List *pathlist,
 											  RelOptInfo *child_rel);
 
+/** modification start **/
+/*
+ * A side index of the pathlist of a rel for add_path, grouping the paths by
+ * their parameterization and their pathkeys as add_path sees them.  Two
+ * paths can only dominate one another if one's pathkeys are a prefix of the
+ * other's and one's required outer rels are a subset of the other's, so
+ * add_path compares a new path with each group once and skips the paths of
+ * unrelated groups.  The index mirrors the pathlist position by position and
+ * is rebuilt whenever the pathlist was changed behind add_path's back.
+ */
+typedef struct PathGroup
+{
+	List	   *pathkeys;		/* NIL for parameterized paths */
+	Relids		required_outer;
+	bool		related;		/* may dominate or be dominated by new path */
+} PathGroup;
+
+typedef struct PathDominanceIndex
+{
+	RelOptInfo *rel;			/* hash key --- MUST BE FIRST */
+	int			npaths;
+	int			maxpaths;
+	Path	  **paths;			/* the pathlist as of our last update */
+	int		   *groups;			/* the group of each path */
+	int			ngroups;
+	int			maxgroups;
+	PathGroup  *groupdata;
+} PathDominanceIndex;
+
+/* Pathlists shorter than this are not worth indexing */
+#define PATH_DOMINANCE_INDEX_MIN_PATHS	8
+
+static HTAB *path_dominance_indexes = NULL;
+static int	path_dominance_indexes_cycle = 0;
+static MemoryContext path_dominance_indexes_cxt = NULL;
+
+static PathDominanceIndex *get_path_dominance_index(RelOptInfo *rel,
+													Path *new_path,
+													List *new_path_pathkeys);
+static int	get_path_group(PathDominanceIndex *index, List *pathkeys,
+						   Relids required_outer);
+static void path_dominance_index_insert(PathDominanceIndex *index, int pos,
+										Path *path, List *pathkeys);
+static void path_dominance_index_delete(PathDominanceIndex *index, int pos);
+/** modification end **/
+
 
 /*****************************************************************************
  *		MISC. PATH UTILITIES
@@ -425,6 +478,9 @@ add_path(RelOptInfo *parent_rel, Path *new_path)
 	int			insert_at = 0;	/* where to insert new item */
 	List	   *new_path_pathkeys;
 	ListCell   *p1;
+	/** modification start **/
+	PathDominanceIndex *index = NULL;
+	/** modification end **/
 
 	/*
 	 * This is a convenient place to check for query cancel --- no part of the
@@ -432,9 +488,34 @@ add_path(RelOptInfo *parent_rel, Path *new_path)
 	 */
 	CHECK_FOR_INTERRUPTS();
 
+	/** modification start **/
+	/*
+	 * In bounded pruning mode, an unsorted join path costing more than a
+	 * known complete plan can't be part of the best one.  Keep it anyway if
+	 * the rel has no path yet, so that every rel of the search stays
+	 * plannable.
+	 */
+	if (parent_rel->pathlist != NIL &&
+		join_cost_exceeds_bound(parent_rel, new_path->total_cost,
+								new_path->pathkeys,
+								PATH_REQ_OUTER(new_path)))
+	{
+		/* Reject and recycle the new path, as below */
+		if (!IsA(new_path, IndexPath))
+			pfree(new_path);
+		return;
+	}
+	/** modification end **/
+
 	/* Pretend parameterized paths have no pathkeys, per comment above */
 	new_path_pathkeys = new_path->param_info ? NIL : new_path->pathkeys;
 
+	/** modification start **/
+	if (enable_path_dominance_index)
+		index = get_path_dominance_index(parent_rel, new_path,
+										 new_path_pathkeys);
+	/** modification end **/
+
 	/*
 	 * Loop to check proposed new path against old paths.  Note it is possible
 	 * for more than one old path to be tossed out because new_path dominates
@@ -448,6 +529,17 @@ add_path(RelOptInfo *parent_rel, Path *new_path)
 		PathKeysComparison keyscmp;
 		BMS_Comparison outercmp;
 
+		/** modification start **/
+		/* Skip the paths that can't dominate or be dominated, see above */
+		if (index != NULL &&
+			!index->groupdata[index->groups[foreach_current_index(p1)]].related)
+		{
+			if (new_path->total_cost >= old_path->total_cost)
+				insert_at = foreach_current_index(p1) + 1;
+			continue;
+		}
+		/** modification end **/
+
 		/*
 		 * Do a fuzzy cost comparison with standard fuzziness limit.
 		 */
@@ -584,6 +676,10 @@ add_path(RelOptInfo *parent_rel, Path *new_path)
 		 */
 		if (remove_old)
 		{
+			/** modification start **/
+			if (index != NULL)
+				path_dominance_index_delete(index, foreach_current_index(p1));
+			/** modification end **/
 			parent_rel->pathlist = foreach_delete_current(parent_rel->pathlist,
 														  p1);
 
@@ -614,6 +710,11 @@ add_path(RelOptInfo *parent_rel, Path *new_path)
 		/* Accept the new path: insert it at proper place in pathlist */
 		parent_rel->pathlist =
 			list_insert_nth(parent_rel->pathlist, insert_at, new_path);
+		/** modification start **/
+		if (index != NULL)
+			path_dominance_index_insert(index, insert_at, new_path,
+										new_path_pathkeys);
+		/** modification end **/
 	}
 	else
 	{
@@ -623,6 +724,225 @@ add_path(RelOptInfo *parent_rel, Path *new_path)
 	}
 }
 
+/** modification start **/
+/*
+ * Forget the dominance indexes when the memory holding them goes away.
+ */
+static void
+reset_path_dominance_indexes(void *arg)
+{
+	if (path_dominance_indexes == (HTAB *) arg)
+	{
+		path_dominance_indexes = NULL;
+		path_dominance_indexes_cxt = NULL;
+	}
+}
+
+/*
+ * get_path_dominance_index
+ *	  Return the up-to-date dominance index of rel's pathlist, with the groups
+ *	  related to new_path marked, or NULL if the pathlist isn't indexed.
+ *
+ * The table lives in the memory context of the first rel we index in the
+ * planning cycle; rels living elsewhere (such as the temporary joinrels of
+ * GEQO) are not indexed.
+ */
+static PathDominanceIndex *
+get_path_dominance_index(RelOptInfo *rel, Path *new_path,
+						 List *new_path_pathkeys)
+{
+	MemoryContext rel_cxt;
+	PathDominanceIndex *index;
+	Relids		new_outer = PATH_REQ_OUTER(new_path);
+	bool		found;
+	bool		valid;
+	ListCell   *lc;
+	int			i;
+
+	if (list_length(rel->pathlist) < PATH_DOMINANCE_INDEX_MIN_PATHS)
+		return NULL;
+
+	rel_cxt = GetMemoryChunkContext(rel);
+	if (path_dominance_indexes != NULL &&
+		path_dominance_indexes_cycle != planning_cycle)
+		hash_destroy(path_dominance_indexes);
+	if (path_dominance_indexes == NULL ||
+		path_dominance_indexes_cycle != planning_cycle)
+	{
+		HASHCTL		ctl;
+		MemoryContextCallback *cb;
+
+		MemSet(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(RelOptInfo *);
+		ctl.entrysize = sizeof(PathDominanceIndex);
+		ctl.hcxt = rel_cxt;
+		path_dominance_indexes = hash_create("Path dominance indexes", 64,
+											 &ctl,
+											 HASH_ELEM | HASH_BLOBS |
+											 HASH_CONTEXT);
+		path_dominance_indexes_cycle = planning_cycle;
+		path_dominance_indexes_cxt = rel_cxt;
+
+		cb = MemoryContextAlloc(rel_cxt, sizeof(MemoryContextCallback));
+		cb->func = reset_path_dominance_indexes;
+		cb->arg = path_dominance_indexes;
+		MemoryContextRegisterResetCallback(rel_cxt, cb);
+	}
+	else if (rel_cxt != path_dominance_indexes_cxt)
+		return NULL;
+
+	index = (PathDominanceIndex *) hash_search(path_dominance_indexes, &rel,
+											   HASH_ENTER, &found);
+	if (!found)
+	{
+		index->npaths = index->maxpaths = 0;
+		index->paths = NULL;
+		index->groups = NULL;
+		index->ngroups = index->maxgroups = 0;
+		index->groupdata = NULL;
+	}
+
+	/* Make sure the index still describes the pathlist, else rebuild it */
+	valid = (index->npaths == list_length(rel->pathlist));
+	if (valid)
+	{
+		foreach(lc, rel->pathlist)
+		{
+			if (index->paths[foreach_current_index(lc)] != lfirst(lc))
+			{
+				valid = false;
+				break;
+			}
+		}
+	}
+	if (!valid)
+	{
+		index->npaths = 0;
+		index->ngroups = 0;
+		foreach(lc, rel->pathlist)
+		{
+			Path	   *path = (Path *) lfirst(lc);
+
+			path_dominance_index_insert(index, index->npaths, path,
+										path->param_info ? NIL : path->pathkeys);
+		}
+	}
+
+	/*
+	 * A path can only be compared with new_path by add_path if the pathkeys
+	 * of one are a prefix of the other's and the required outer rels of one
+	 * are a subset of the other's; all other pairs are kept as they are.
+	 */
+	for (i = 0; i < index->ngroups; i++)
+	{
+		PathGroup  *group = &index->groupdata[i];
+
+		group->related =
+			compare_pathkeys(new_path_pathkeys,
+							 group->pathkeys) != PATHKEYS_DIFFERENT &&
+			bms_subset_compare(new_outer,
+							   group->required_outer) != BMS_DIFFERENT;
+	}
+
+	return index;
+}
+
+/*
+ * Find or make the group of paths with the given pathkeys and parameterization
+ */
+static int
+get_path_group(PathDominanceIndex *index, List *pathkeys,
+			   Relids required_outer)
+{
+	PathGroup  *group;
+	int			i;
+
+	for (i = 0; i < index->ngroups; i++)
+	{
+		group = &index->groupdata[i];
+		if (compare_pathkeys(pathkeys, group->pathkeys) == PATHKEYS_EQUAL &&
+			bms_equal(required_outer, group->required_outer))
+			return i;
+	}
+
+	if (index->ngroups >= index->maxgroups)
+	{
+		index->maxgroups = Max(index->maxgroups * 2, 8);
+		if (index->groupdata == NULL)
+			index->groupdata = (PathGroup *)
+				palloc(index->maxgroups * sizeof(PathGroup));
+		else
+			index->groupdata = (PathGroup *)
+				repalloc(index->groupdata, index->maxgroups * sizeof(PathGroup));
+	}
+
+	/* add_path frees only Path nodes, never their pathkeys or param_info */
+	group = &index->groupdata[index->ngroups];
+	group->pathkeys = pathkeys;
+	group->required_outer = required_outer;
+	group->related = true;		/* not compared with the new path, if any */
+
+	return index->ngroups++;
+}
+
+/*
+ * Enter path into the index at position pos of the pathlist
+ */
+static void
+path_dominance_index_insert(PathDominanceIndex *index, int pos, Path *path,
+							List *pathkeys)
+{
+	MemoryContext oldcxt;
+	int			group;
+
+	oldcxt = MemoryContextSwitchTo(path_dominance_indexes_cxt);
+
+	if (index->npaths >= index->maxpaths)
+	{
+		index->maxpaths = Max(index->maxpaths * 2,
+							  PATH_DOMINANCE_INDEX_MIN_PATHS * 2);
+		if (index->paths == NULL)
+		{
+			index->paths = (Path **) palloc(index->maxpaths * sizeof(Path *));
+			index->groups = (int *) palloc(index->maxpaths * sizeof(int));
+		}
+		else
+		{
+			index->paths = (Path **)
+				repalloc(index->paths, index->maxpaths * sizeof(Path *));
+			index->groups = (int *)
+				repalloc(index->groups, index->maxpaths * sizeof(int));
+		}
+	}
+	group = get_path_group(index, pathkeys, PATH_REQ_OUTER(path));
+
+	MemoryContextSwitchTo(oldcxt);
+
+	Assert(pos >= 0 && pos <= index->npaths);
+	memmove(&index->paths[pos + 1], &index->paths[pos],
+			(index->npaths - pos) * sizeof(Path *));
+	memmove(&index->groups[pos + 1], &index->groups[pos],
+			(index->npaths - pos) * sizeof(int));
+	index->paths[pos] = path;
+	index->groups[pos] = group;
+	index->npaths++;
+}
+
+/*
+ * Remove the path at position pos of the pathlist from the index
+ */
+static void
+path_dominance_index_delete(PathDominanceIndex *index, int pos)
+{
+	Assert(pos >= 0 && pos < index->npaths);
+	memmove(&index->paths[pos], &index->paths[pos + 1],
+			(index->npaths - pos - 1) * sizeof(Path *));
+	memmove(&index->groups[pos], &index->groups[pos + 1],
+			(index->npaths - pos - 1) * sizeof(int));
+	index->npaths--;
+}
+/** modification end **/
+
 /*
  * add_path_precheck
  *	  Check whether a proposed new path could possibly get accepted.
@@ -649,6 +969,21 @@ add_path_precheck(RelOptInfo *parent_rel,
 	bool		consider_startup;
 	ListCell   *p1;
 
+	/** modification start **/
+	/*
+	 * The costs of a cost provider's model needn't be above the lower bounds
+	 * we are given, so we can't reject anything then.
+	 */
+	if (enable_cost_provider && cost_provider_handles_joins())
+		return true;
+
+	/* Reject paths above the join cost bound, per add_path */
+	if (parent_rel->pathlist != NIL &&
+		join_cost_exceeds_bound(parent_rel, total_cost, pathkeys,
+								required_outer))
+		return false;
+	/** modification end **/
+
 	/* Pretend parameterized paths have no pathkeys, per add_path policy */
 	new_path_pathkeys = required_outer ? NIL : pathkeys;
 
@@ -869,6 +1204,12 @@ add_partial_path_precheck(RelOptInfo *parent_rel, Cost total_cost,
 {
 	ListCell   *p1;
 
+	/** modification start **/
+	/* Costs of a cost provider don't respect our lower bound, per above */
+	if (enable_cost_provider && cost_provider_handles_joins())
+		return true;
+	/** modification end **/
+
 	/*
 	 * Our goal here is twofold.  First, we want to find out whether this path
 	 * is clearly inferior to some existing partial path.  If so, we want to
@@ -52,6 +52,35 @@
 #include "utils/rel.h"
 #include "utils/snapmgr.h"
 #include "utils/syscache.h"
+/** modification start **/
+#include "optimizer/pilotscope_paths.h"
+#include "storage/lmgr.h"
+#include "utils/hsearch.h"
+#include "utils/inval.h"
+#include "utils/memutils.h"
+#include "utils/pilotscope_guc.h"
+
+/*
+ * Backend-local cache of the indexes and extended statistics that
+ * get_relation_info derives for a plain relation, keyed by relation OID.
+ * The cached IndexOptInfos and StatisticExtInfos are templates with varno 1
+ * and no rel; each use gets a copy fixed up for its RelOptInfo.
+ *
+ * Entries are dropped by relcache invalidations of the relation or of one
+ * of its indexes.  The physical index sizes are cached too, so an entry is
+ * also rebuilt when the size estimate of the relation has changed.
+ */
+typedef struct RelationInfoCacheEntry
+{
+	Oid			relid;			/* hash key --- MUST BE FIRST */
+	MemoryContext cxt;			/* holds everything below */
+	BlockNumber pages;			/* rel->pages the entry was built with */
+	List	   *indexes;		/* IndexOptInfo templates */
+	List	   *statlist;		/* StatisticExtInfo templates */
+} RelationInfoCacheEntry;
+
+static HTAB *relation_info_cache = NULL;
+/** modification end **/
 
 /* GUC parameter */
 int			constraint_exclusion = CONSTRAINT_EXCLUSION_PARTITION;
@@ -75,6 +104,13 @@ static List *get_relation_statistics(RelOptInfo *rel, Relation relation);
 static void set_relation_partition_info(PlannerInfo *root, RelOptInfo *rel,
 										Relation relation);
 static PartitionScheme find_partition_scheme(PlannerInfo *root, Relation rel);
+/** modification start **/
+static bool get_cached_relation_info(Oid relid, RelOptInfo *rel,
+									 LOCKMODE lmode);
+static void store_cached_relation_info(Oid relid, RelOptInfo *rel);
+static IndexOptInfo *copy_index_opt_info(IndexOptInfo *src);
+static void invalidate_relation_info_cache(Datum arg, Oid relid);
+/** modification end **/
 static void set_baserel_partition_key_exprs(Relation relation,
 											RelOptInfo *rel);
 static void set_baserel_partition_constraint(Relation relation,
@@ -117,6 +153,10 @@ get_relation_info(PlannerInfo *root, Oid relationObjectId, bool inhparent,
 	Relation	relation;
 	bool		hasindex;
 	List	   *indexinfos = NIL;
+	/** modification start **/
+	bool		cached;
+	bool		cacheable;
+	/** modification end **/
 
 	/*
 	 * We need not lock the relation since it was already locked, either by
@@ -163,6 +203,19 @@ get_relation_info(PlannerInfo *root, Oid relationObjectId, bool inhparent,
 	else
 		hasindex = relation->rd_rel->relhasindex;
 
+	/** modification start **/
+	/*
+	 * Take the indexes and extended statistics from the cache if we can; the
+	 * foreign keys and partitioning info below depend on the query.
+	 */
+	cached = (enable_relation_info_cache && !inhparent &&
+			  get_cached_relation_info(relationObjectId, rel,
+									   root->simple_rte_array[varno]->rellockmode));
+	if (cached)
+		hasindex = false;
+	cacheable = enable_relation_info_cache && !inhparent && !cached;
+	/** modification end **/
+
 	if (hasindex)
 	{
 		List	   *indexoidlist;
@@ -232,6 +285,10 @@ get_relation_info(PlannerInfo *root, Oid relationObjectId, bool inhparent,
 			{
 				root->glob->transientPlan = true;
 				index_close(indexRelation, NoLock);
+				/** modification start **/
+				/* the set of usable indexes may change soon */
+				cacheable = false;
+				/** modification end **/
 				continue;
 			}
 
@@ -432,14 +489,26 @@ get_relation_info(PlannerInfo *root, Oid relationObjectId, bool inhparent,
 			 * that the O(N^2) behavior of lcons() is really a problem.
 			 */
 			indexinfos = lcons(info, indexinfos);
+
+			/** modification start **/
+			register_index_key_attnos(info);
+			/** modification end **/
 		}
 
 		list_free(indexoidlist);
 	}
 
-	rel->indexlist = indexinfos;
+	/** modification start **/
+	if (!cached)
+	{
+		rel->indexlist = indexinfos;
+
+		rel->statlist = get_relation_statistics(rel, relation);
 
-	rel->statlist = get_relation_statistics(rel, relation);
+		if (cacheable)
+			store_cached_relation_info(relationObjectId, rel);
+	}
+	/** modification end **/
 
 	/* Grab foreign-table info using the relcache, while we have it */
 	if (relation->rd_rel->relkind == RELKIND_FOREIGN_TABLE)
@@ -474,6 +543,263 @@ get_relation_info(PlannerInfo *root, Oid relationObjectId, bool inhparent,
 		(*get_relation_info_hook) (root, relationObjectId, inhparent, rel);
 }
 
+/** modification start **/
+/*
+ * get_cached_relation_info
+ *	  Set rel->indexlist and rel->statlist from the relation info cache.
+ *	  Returns false if there is no valid entry for the relation.
+ *
+ * rel->pages and rel->tuples must have been estimated already.  We take the
+ * same locks on the indexes as the uncached path does, since the executor
+ * relies on them.
+ *
+ * Taking a lock may process invalidation messages, which can drop the entry
+ * (e.g. for a concurrently created, dropped or reindexed index).  So we lock
+ * all the cached indexes first, from a copy of their OIDs, and only use the
+ * entry if it is still there afterwards.  Once we hold the locks, no index
+ * of the relation can change under us.
+ */
+static bool
+get_cached_relation_info(Oid relid, RelOptInfo *rel, LOCKMODE lmode)
+{
+	RelationInfoCacheEntry *entry;
+	List	   *indexoids = NIL;
+	ListCell   *lc;
+
+	if (relation_info_cache == NULL)
+		return false;
+
+	entry = (RelationInfoCacheEntry *) hash_search(relation_info_cache,
+												   &relid, HASH_FIND, NULL);
+	if (entry == NULL || entry->pages != rel->pages)
+		return false;
+
+	foreach(lc, entry->indexes)
+		indexoids = lappend_oid(indexoids,
+								((IndexOptInfo *) lfirst(lc))->indexoid);
+
+	/* entry must not be touched from here until we look it up again */
+	foreach(lc, indexoids)
+		LockRelationOid(lfirst_oid(lc), lmode);
+	list_free(indexoids);
+
+	/*
+	 * If the entry was dropped meanwhile, the caller reads the catalogs.  The
+	 * locks we took on indexes that are gone are harmless; the uncached path
+	 * takes the same ones on the indexes still there.
+	 */
+	entry = (RelationInfoCacheEntry *) hash_search(relation_info_cache,
+												   &relid, HASH_FIND, NULL);
+	if (entry == NULL || entry->pages != rel->pages)
+		return false;
+
+	rel->indexlist = NIL;
+	foreach(lc, entry->indexes)
+	{
+		IndexOptInfo *info = copy_index_opt_info((IndexOptInfo *) lfirst(lc));
+
+		info->rel = rel;
+		if (rel->relid != 1)
+		{
+			ChangeVarNodes((Node *) info->indexprs, 1, rel->relid, 0);
+			ChangeVarNodes((Node *) info->indpred, 1, rel->relid, 0);
+			ChangeVarNodes((Node *) info->indextlist, 1, rel->relid, 0);
+		}
+
+		/* As in get_relation_info, the index is not larger than the table */
+		if (info->indpred == NIL || info->tuples > rel->tuples)
+			info->tuples = rel->tuples;
+
+		rel->indexlist = lappend(rel->indexlist, info);
+	}
+
+	rel->statlist = NIL;
+	foreach(lc, entry->statlist)
+	{
+		StatisticExtInfo *info = makeNode(StatisticExtInfo);
+
+		memcpy(info, lfirst(lc), sizeof(StatisticExtInfo));
+		info->rel = rel;
+		info->keys = bms_copy(info->keys);
+		rel->statlist = lappend(rel->statlist, info);
+	}
+
+	return true;
+}
+
+/*
+ * store_cached_relation_info
+ *	  Remember rel->indexlist and rel->statlist as just built from the
+ *	  catalogs, replacing any former entry of the relation.
+ */
+static void
+store_cached_relation_info(Oid relid, RelOptInfo *rel)
+{
+	RelationInfoCacheEntry *entry;
+	MemoryContext oldcxt;
+	ListCell   *lc;
+	bool		found;
+
+	if (relation_info_cache == NULL)
+	{
+		HASHCTL		hash_ctl;
+
+		MemSet(&hash_ctl, 0, sizeof(hash_ctl));
+		hash_ctl.keysize = sizeof(Oid);
+		hash_ctl.entrysize = sizeof(RelationInfoCacheEntry);
+		hash_ctl.hcxt = CacheMemoryContext;
+		relation_info_cache = hash_create("PilotScope relation info cache",
+										  256L,
+										  &hash_ctl,
+										  HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+		CacheRegisterRelcacheCallback(invalidate_relation_info_cache,
+									  (Datum) 0);
+	}
+
+	entry = (RelationInfoCacheEntry *) hash_search(relation_info_cache,
+												   &relid, HASH_ENTER, &found);
+	if (found)
+		MemoryContextDelete(entry->cxt);
+
+	entry->cxt = AllocSetContextCreate(CacheMemoryContext,
+									   "PilotScope relation info",
+									   ALLOCSET_SMALL_SIZES);
+	entry->pages = rel->pages;
+	entry->indexes = NIL;
+	entry->statlist = NIL;
+
+	oldcxt = MemoryContextSwitchTo(entry->cxt);
+
+	foreach(lc, rel->indexlist)
+	{
+		IndexOptInfo *info = copy_index_opt_info((IndexOptInfo *) lfirst(lc));
+
+		info->rel = NULL;
+		if (rel->relid != 1)
+		{
+			ChangeVarNodes((Node *) info->indexprs, rel->relid, 1, 0);
+			ChangeVarNodes((Node *) info->indpred, rel->relid, 1, 0);
+			ChangeVarNodes((Node *) info->indextlist, rel->relid, 1, 0);
+		}
+		entry->indexes = lappend(entry->indexes, info);
+	}
+
+	foreach(lc, rel->statlist)
+	{
+		StatisticExtInfo *info = makeNode(StatisticExtInfo);
+
+		memcpy(info, lfirst(lc), sizeof(StatisticExtInfo));
+		info->rel = NULL;
+		info->keys = bms_copy(info->keys);
+		entry->statlist = lappend(entry->statlist, info);
+	}
+
+	MemoryContextSwitchTo(oldcxt);
+}
+
+/*
+ * copy_index_opt_info
+ *	  Copy an IndexOptInfo built by get_relation_info, in the current memory
+ *	  context.  The fields set later by indxpath.c are reset.
+ */
+static IndexOptInfo *
+copy_index_opt_info(IndexOptInfo *src)
+{
+	IndexOptInfo *info = makeNode(IndexOptInfo);
+	int			ncolumns = src->ncolumns;
+	int			nkeycolumns = src->nkeycolumns;
+	int			i;
+
+	memcpy(info, src, sizeof(IndexOptInfo));
+
+	info->indexkeys = (int *) palloc(sizeof(int) * ncolumns);
+	memcpy(info->indexkeys, src->indexkeys, sizeof(int) * ncolumns);
+	info->canreturn = (bool *) palloc(sizeof(bool) * ncolumns);
+	memcpy(info->canreturn, src->canreturn, sizeof(bool) * ncolumns);
+	info->indexcollations = (Oid *) palloc(sizeof(Oid) * nkeycolumns);
+	memcpy(info->indexcollations, src->indexcollations,
+		   sizeof(Oid) * nkeycolumns);
+	info->opfamily = (Oid *) palloc(sizeof(Oid) * nkeycolumns);
+	memcpy(info->opfamily, src->opfamily, sizeof(Oid) * nkeycolumns);
+	info->opcintype = (Oid *) palloc(sizeof(Oid) * nkeycolumns);
+	memcpy(info->opcintype, src->opcintype, sizeof(Oid) * nkeycolumns);
+
+	/* btree indexes share the opfamily array, see get_relation_info */
+	if (src->sortopfamily == src->opfamily)
+		info->sortopfamily = info->opfamily;
+	else if (src->sortopfamily != NULL)
+	{
+		info->sortopfamily = (Oid *) palloc(sizeof(Oid) * nkeycolumns);
+		memcpy(info->sortopfamily, src->sortopfamily,
+			   sizeof(Oid) * nkeycolumns);
+	}
+	if (src->reverse_sort != NULL)
+	{
+		info->reverse_sort = (bool *) palloc(sizeof(bool) * nkeycolumns);
+		memcpy(info->reverse_sort, src->reverse_sort,
+			   sizeof(bool) * nkeycolumns);
+	}
+	if (src->nulls_first != NULL)
+	{
+		info->nulls_first = (bool *) palloc(sizeof(bool) * nkeycolumns);
+		memcpy(info->nulls_first, src->nulls_first,
+			   sizeof(bool) * nkeycolumns);
+	}
+	if (src->opclassoptions != NULL)
+	{
+		info->opclassoptions = (bytea **) palloc0(sizeof(bytea *) * ncolumns);
+		for (i = 0; i < ncolumns; i++)
+		{
+			if (src->opclassoptions[i] == NULL)
+				continue;
+			info->opclassoptions[i] =
+				(bytea *) palloc(VARSIZE(src->opclassoptions[i]));
+			memcpy(info->opclassoptions[i], src->opclassoptions[i],
+				   VARSIZE(src->opclassoptions[i]));
+		}
+	}
+
+	info->indexprs = copyObject(src->indexprs);
+	info->indpred = copyObject(src->indpred);
+	info->indextlist = copyObject(src->indextlist);
+	info->indrestrictinfo = NIL;
+	info->predOK = false;
+
+	return info;
+}
+
+/*
+ * invalidate_relation_info_cache
+ *	  Relcache callback: drop the entries of the relation, or of the table of
+ *	  the index, or all entries if relid is InvalidOid.
+ */
+static void
+invalidate_relation_info_cache(Datum arg, Oid relid)
+{
+	HASH_SEQ_STATUS status;
+	RelationInfoCacheEntry *entry;
+
+	hash_seq_init(&status, relation_info_cache);
+	while ((entry = (RelationInfoCacheEntry *) hash_seq_search(&status)) != NULL)
+	{
+		bool		drop = (relid == InvalidOid || entry->relid == relid);
+		ListCell   *lc;
+
+		foreach(lc, entry->indexes)
+		{
+			if (((IndexOptInfo *) lfirst(lc))->indexoid == relid)
+				drop = true;
+		}
+
+		if (drop)
+		{
+			MemoryContextDelete(entry->cxt);
+			hash_search(relation_info_cache, &entry->relid, HASH_REMOVE, NULL);
+		}
+	}
+}
+/** modification end **/
+
 /*
  * get_relation_foreign_keys -
  *	  Retrieves foreign key information for a given relation.
@@ -28,6 +28,16 @@
 #include "utils/lsyscache.h"
 #include "utils/syscache.h"
 
+/** modification start **/
+#include "common/hashfn.h"
+#include "rewrite/rewriteManip.h"
+#include "utils/datum.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+#include "utils/pilotscope_guc.h"
+#include "anchor2struct.h"
+/** modification end **/
+
 
 /*
  * Proof attempts involving large arrays in ScalarArrayOpExpr nodes are
@@ -110,6 +120,69 @@ static bool operator_same_subexprs_lookup(Oid pred_op, Oid clause_op,
 static Oid	get_btree_test_op(Oid pred_op, Oid clause_op, bool refute_it);
 static void InvalidateOprProofCacheCallBack(Datum arg, int cacheid, uint32 hashvalue);
 
+/** modification start **/
+/*
+ * Per-planning cache of the results of predicate_implied_by and
+ * predicate_refuted_by.  The same proofs are attempted over and over, e.g.
+ * for every child of an inheritance tree with the same CHECK constraints, so
+ * we remember them by content.  The inputs are hashed ignoring varnos, and
+ * when they reference a single relation they are kept with its varno changed
+ * to 1, so that proofs about different children of a parent share entries.
+ * The result of a proof does not depend on the varnos, only on which Vars
+ * are equal.
+ */
+typedef struct PredicateProof
+{
+	List	   *predicate_list; /* normalized copies of the inputs */
+	List	   *clause_list;
+	bool		weak;
+	bool		refute_it;
+	bool		result;
+} PredicateProof;
+
+typedef struct PredicateProofEntry
+{
+	uint32		hash;			/* hash key --- MUST BE FIRST */
+	List	   *proofs;			/* PredicateProofs with this hash */
+} PredicateProofEntry;
+
+/* State passed from lookup_predicate_proof to remember_predicate_proof */
+typedef struct PredicateProofLookup
+{
+	PredicateProofEntry *entry; /* where to remember the proof, or NULL */
+	List	   *predicate_list; /* normalized inputs */
+	List	   *clause_list;
+	bool		weak;
+	bool		refute_it;
+} PredicateProofLookup;
+
+/* What examine_proof_input learns about one input of a proof */
+typedef struct ProofInputInfo
+{
+	uint32		hash;			/* hash of the content, ignoring varnos */
+	Bitmapset  *signature;		/* hashed Vars, see proof_signature_bit */
+	Relids		varnos;			/* varnos of the Vars of this query level */
+	int			nvars;			/* number of Vars seen so far */
+	bool		atoms_have_vars;	/* does every atom reference some Var? */
+} ProofInputInfo;
+
+/* Number of bits of the Var signatures of ProofInputInfo */
+#define PROOF_SIGNATURE_BITS	256
+
+static HTAB *predicate_proof_cache = NULL;
+static MemoryContext predicate_proof_cxt = NULL;
+static int	predicate_proof_cache_cycle = 0;
+
+static bool lookup_predicate_proof(List *predicate_list, List *clause_list,
+								   bool weak, bool refute_it,
+								   PredicateProofLookup *lookup, bool *result);
+static void remember_predicate_proof(PredicateProofLookup *lookup, bool result);
+static List *strip_proof_restrictinfos(List *clause_list);
+static void examine_proof_input(Node *node, ProofInputInfo *info);
+static bool proof_input_walker(Node *node, ProofInputInfo *info);
+static int	proof_signature_bit(Index varno, int attno, Index levelsup);
+/** modification end **/
+
 
 /*
  * predicate_implied_by
@@ -153,12 +226,22 @@ predicate_implied_by(List *predicate_list, List *clause_list,
 {
 	Node	   *p,
 			   *c;
+	/** modification start **/
+	PredicateProofLookup lookup;
+	bool		result;
+	/** modification end **/
 
 	if (predicate_list == NIL)
 		return true;			/* no predicate: implication is vacuous */
 	if (clause_list == NIL)
 		return false;			/* no restriction: implication must fail */
 
+	/** modification start **/
+	if (lookup_predicate_proof(predicate_list, clause_list, weak, false,
+							   &lookup, &result))
+		return result;
+	/** modification end **/
+
 	/*
 	 * If either input is a single-element list, replace it with its lone
 	 * member; this avoids one useless level of AND-recursion.  We only need
@@ -175,7 +258,12 @@ predicate_implied_by(List *predicate_list, List *clause_list,
 		c = (Node *) clause_list;
 
 	/* And away we go ... */
-	return predicate_implied_by_recurse(c, p, weak);
+	/** modification start **/
+	result = predicate_implied_by_recurse(c, p, weak);
+	remember_predicate_proof(&lookup, result);
+
+	return result;
+	/** modification end **/
 }
 
 /*
@@ -223,12 +311,22 @@ predicate_refuted_by(List *predicate_list, List *clause_list,
 {
 	Node	   *p,
 			   *c;
+	/** modification start **/
+	PredicateProofLookup lookup;
+	bool		result;
+	/** modification end **/
 
 	if (predicate_list == NIL)
 		return false;			/* no predicate: no refutation is possible */
 	if (clause_list == NIL)
 		return false;			/* no restriction: refutation must fail */
 
+	/** modification start **/
+	if (lookup_predicate_proof(predicate_list, clause_list, weak, true,
+							   &lookup, &result))
+		return result;
+	/** modification end **/
+
 	/*
 	 * If either input is a single-element list, replace it with its lone
 	 * member; this avoids one useless level of AND-recursion.  We only need
@@ -245,7 +343,12 @@ predicate_refuted_by(List *predicate_list, List *clause_list,
 		c = (Node *) clause_list;
 
 	/* And away we go ... */
-	return predicate_refuted_by_recurse(c, p, weak);
+	/** modification start **/
+	result = predicate_refuted_by_recurse(c, p, weak);
+	remember_predicate_proof(&lookup, result);
+
+	return result;
+	/** modification end **/
 }
 
 /*----------
@@ -2223,3 +2326,348 @@ InvalidateOprProofCacheCallBack(Datum arg, int cacheid, uint32 hashvalue)
 		hentry->have_refute = false;
 	}
 }
+
+/** modification start **/
+/*
+ * lookup_predicate_proof
+ *	  Try to answer a proof of predicate_implied_by (refute_it = false) or
+ *	  predicate_refuted_by (refute_it = true) without attempting it.
+ *
+ * Returns true and sets *result if the answer is known.  Otherwise fills
+ * *lookup so that remember_predicate_proof can keep the answer the caller
+ * works out.
+ *
+ * Besides the cache, we have a fast path for inputs that have no Var in
+ * common: two atoms can only be proven to imply or refute each other if they
+ * share a subexpression (see predicate_implied_by_simple_clause and
+ * predicate_refuted_by_simple_clause), so if every atom references a Var and
+ * no Var appears on both sides, nothing can be proven.
+ */
+static bool
+lookup_predicate_proof(List *predicate_list, List *clause_list,
+					   bool weak, bool refute_it,
+					   PredicateProofLookup *lookup, bool *result)
+{
+	ProofInputInfo pinfo;
+	ProofInputInfo cinfo;
+	Relids		varnos;
+	int			varno;
+	uint32		hash;
+	bool		found;
+	ListCell   *lc;
+
+	lookup->entry = NULL;
+
+	if (!enable_predicate_proof_cache)
+		return false;
+
+	clause_list = strip_proof_restrictinfos(clause_list);
+
+	MemSet(&pinfo, 0, sizeof(pinfo));
+	pinfo.atoms_have_vars = true;
+	examine_proof_input((Node *) predicate_list, &pinfo);
+	MemSet(&cinfo, 0, sizeof(cinfo));
+	cinfo.atoms_have_vars = true;
+	examine_proof_input((Node *) clause_list, &cinfo);
+
+	if (pinfo.atoms_have_vars && cinfo.atoms_have_vars &&
+		!bms_overlap(pinfo.signature, cinfo.signature))
+	{
+		*result = false;
+		return true;
+	}
+
+	/* Start a new cache for each planning */
+	if (predicate_proof_cache == NULL ||
+		predicate_proof_cache_cycle != planning_cycle)
+	{
+		HASHCTL		hash_ctl;
+
+		if (predicate_proof_cxt == NULL)
+			predicate_proof_cxt = AllocSetContextCreate(TopMemoryContext,
+														"PredicateProofCache",
+														ALLOCSET_DEFAULT_SIZES);
+		else
+			MemoryContextReset(predicate_proof_cxt);
+
+		MemSet(&hash_ctl, 0, sizeof(hash_ctl));
+		hash_ctl.keysize = sizeof(uint32);
+		hash_ctl.entrysize = sizeof(PredicateProofEntry);
+		hash_ctl.hcxt = predicate_proof_cxt;
+		predicate_proof_cache = hash_create("PredicateProofCache",
+											256L,
+											&hash_ctl,
+											HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+		predicate_proof_cache_cycle = planning_cycle;
+	}
+
+	hash = hash_combine(pinfo.hash, cinfo.hash);
+	hash = hash_combine(hash, (weak ? 1 : 0) | (refute_it ? 2 : 0));
+	lookup->entry = (PredicateProofEntry *) hash_search(predicate_proof_cache,
+														&hash,
+														HASH_ENTER,
+														&found);
+	if (!found)
+		lookup->entry->proofs = NIL;
+
+	/* Normalize the varno of single-relation inputs, see PredicateProof */
+	varnos = bms_union(pinfo.varnos, cinfo.varnos);
+	if (bms_get_singleton_member(varnos, &varno) && varno != 1)
+	{
+		predicate_list = copyObject(predicate_list);
+		clause_list = copyObject(clause_list);
+		ChangeVarNodes((Node *) predicate_list, varno, 1, 0);
+		ChangeVarNodes((Node *) clause_list, varno, 1, 0);
+	}
+	lookup->predicate_list = predicate_list;
+	lookup->clause_list = clause_list;
+	lookup->weak = weak;
+	lookup->refute_it = refute_it;
+
+	foreach(lc, lookup->entry->proofs)
+	{
+		PredicateProof *proof = (PredicateProof *) lfirst(lc);
+
+		if (proof->weak == weak && proof->refute_it == refute_it &&
+			equal(proof->predicate_list, predicate_list) &&
+			equal(proof->clause_list, clause_list))
+		{
+			*result = proof->result;
+			lookup->entry = NULL;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * remember_predicate_proof
+ *	  Keep the result of a proof that lookup_predicate_proof couldn't answer.
+ */
+static void
+remember_predicate_proof(PredicateProofLookup *lookup, bool result)
+{
+	MemoryContext oldcxt;
+	PredicateProof *proof;
+
+	if (lookup->entry == NULL)
+		return;
+
+	oldcxt = MemoryContextSwitchTo(predicate_proof_cxt);
+	proof = (PredicateProof *) palloc(sizeof(PredicateProof));
+	proof->predicate_list = copyObject(lookup->predicate_list);
+	proof->clause_list = copyObject(lookup->clause_list);
+	proof->weak = lookup->weak;
+	proof->refute_it = lookup->refute_it;
+	proof->result = result;
+	lookup->entry->proofs = lappend(lookup->entry->proofs, proof);
+	MemoryContextSwitchTo(oldcxt);
+}
+
+/*
+ * strip_proof_restrictinfos
+ *	  Replace the RestrictInfos of a clause list by their clauses, which is
+ *	  all the proof routines look at.
+ */
+static List *
+strip_proof_restrictinfos(List *clause_list)
+{
+	List	   *result = NIL;
+	ListCell   *lc;
+
+	foreach(lc, clause_list)
+	{
+		if (IsA(lfirst(lc), RestrictInfo))
+			break;
+	}
+	if (lc == NULL)
+		return clause_list;
+
+	foreach(lc, clause_list)
+	{
+		Node	   *clause = (Node *) lfirst(lc);
+
+		if (IsA(clause, RestrictInfo))
+			clause = (Node *) ((RestrictInfo *) clause)->clause;
+		result = lappend(result, clause);
+	}
+
+	return result;
+}
+
+/*
+ * examine_proof_input
+ *	  Hash an input of a proof and collect its Vars into *info.
+ *
+ * This follows the AND/OR/NOT structure the proof routines look through, so
+ * that we can tell whether each atom references some Var.  An atom without
+ * Vars, or a vacuous AND or OR such as an ALL over an empty array, clears
+ * info->atoms_have_vars.
+ */
+static void
+examine_proof_input(Node *node, ProofInputInfo *info)
+{
+	ListCell   *lc;
+	int			nvars = info->nvars;
+
+	if (node == NULL)
+	{
+		info->atoms_have_vars = false;
+		return;
+	}
+
+	if (IsA(node, RestrictInfo))
+		node = (Node *) ((RestrictInfo *) node)->clause;
+
+	info->hash = hash_combine(info->hash, (uint32) nodeTag(node));
+
+	if (IsA(node, List))
+	{
+		foreach(lc, (List *) node)
+			examine_proof_input((Node *) lfirst(lc), info);
+	}
+	else if (IsA(node, BoolExpr))
+	{
+		info->hash = hash_combine(info->hash,
+								  (uint32) ((BoolExpr *) node)->boolop);
+		foreach(lc, ((BoolExpr *) node)->args)
+			examine_proof_input((Node *) lfirst(lc), info);
+	}
+	else if (IsA(node, BooleanTest))
+	{
+		info->hash = hash_combine(info->hash,
+								  (uint32) ((BooleanTest *) node)->booltesttype);
+		examine_proof_input((Node *) ((BooleanTest *) node)->arg, info);
+	}
+	else if (IsA(node, ScalarArrayOpExpr))
+	{
+		/* Deconstructed into atoms of the scalar and each element */
+		ScalarArrayOpExpr *saop = (ScalarArrayOpExpr *) node;
+		Node	   *arraynode = (Node *) lsecond(saop->args);
+
+		info->hash = hash_combine(info->hash, (uint32) saop->opno);
+		info->hash = hash_combine(info->hash, (uint32) saop->useOr);
+		(void) proof_input_walker((Node *) linitial(saop->args), info);
+		if (info->nvars == nvars)
+			info->atoms_have_vars = false;
+		(void) proof_input_walker(arraynode, info);
+
+		if (arraynode && IsA(arraynode, Const) &&
+			!((Const *) arraynode)->constisnull)
+		{
+			ArrayType  *arrayval = DatumGetArrayTypeP(((Const *) arraynode)->constvalue);
+
+			if (ArrayGetNItems(ARR_NDIM(arrayval), ARR_DIMS(arrayval)) == 0)
+				info->atoms_have_vars = false;
+		}
+		else if (arraynode && IsA(arraynode, ArrayExpr) &&
+				 ((ArrayExpr *) arraynode)->elements == NIL)
+			info->atoms_have_vars = false;
+	}
+	else
+	{
+		(void) proof_input_walker(node, info);
+		if (info->nvars == nvars)
+			info->atoms_have_vars = false;
+	}
+}
+
+/*
+ * proof_input_walker
+ *	  Hash an expression and collect its Vars, for examine_proof_input.
+ *
+ * The hash must agree with equal(), so we look at no more than it does.
+ */
+static bool
+proof_input_walker(Node *node, ProofInputInfo *info)
+{
+	if (node == NULL)
+		return false;
+
+	if (IsA(node, RestrictInfo))
+		return proof_input_walker((Node *) ((RestrictInfo *) node)->clause,
+								  info);
+
+	info->hash = hash_combine(info->hash, (uint32) nodeTag(node));
+
+	if (IsA(node, Var))
+	{
+		Var		   *var = (Var *) node;
+
+		info->hash = hash_combine(info->hash, (uint32) var->varattno);
+		info->hash = hash_combine(info->hash, var->varlevelsup);
+		info->signature = bms_add_member(info->signature,
+										 proof_signature_bit(var->varno,
+															 var->varattno,
+															 var->varlevelsup));
+		if (var->varlevelsup == 0)
+			info->varnos = bms_add_member(info->varnos, var->varno);
+		info->nvars++;
+		return false;
+	}
+	if (IsA(node, PlaceHolderVar))
+	{
+		/* equal() compares nothing but these two */
+		PlaceHolderVar *phv = (PlaceHolderVar *) node;
+
+		info->hash = hash_combine(info->hash, phv->phid);
+		info->hash = hash_combine(info->hash, phv->phlevelsup);
+		info->signature = bms_add_member(info->signature,
+										 proof_signature_bit(0,
+															 phv->phid,
+															 phv->phlevelsup));
+		info->nvars++;
+		return false;
+	}
+	if (IsA(node, Const))
+	{
+		Const	   *con = (Const *) node;
+
+		info->hash = hash_combine(info->hash, (uint32) con->consttype);
+		if (con->constisnull)
+			info->hash = hash_combine(info->hash, 0);
+		else if (con->constbyval)
+			info->hash = hash_combine(info->hash,
+									  DatumGetUInt32(hash_any((unsigned char *) &con->constvalue,
+															  sizeof(Datum))));
+		else
+			info->hash = hash_combine(info->hash,
+									  DatumGetUInt32(hash_any((unsigned char *) DatumGetPointer(con->constvalue),
+															  datumGetSize(con->constvalue,
+																		   false,
+																		   con->constlen))));
+		return false;
+	}
+	if (IsA(node, Query))
+		return false;
+
+	if (IsA(node, OpExpr))
+		info->hash = hash_combine(info->hash, (uint32) ((OpExpr *) node)->opno);
+	else if (IsA(node, FuncExpr))
+		info->hash = hash_combine(info->hash, (uint32) ((FuncExpr *) node)->funcid);
+	else if (IsA(node, NullTest))
+		info->hash = hash_combine(info->hash,
+								  (uint32) ((NullTest *) node)->nulltesttype);
+
+	return expression_tree_walker(node, proof_input_walker, (void *) info);
+}
+
+/*
+ * proof_signature_bit
+ *	  Map a Var, or a PlaceHolderVar with varno 0, to a bit of a signature.
+ *
+ * Different Vars may share a bit, which only makes the fast path of
+ * lookup_predicate_proof give up more often.
+ */
+static int
+proof_signature_bit(Index varno, int attno, Index levelsup)
+{
+	uint32		hash;
+
+	hash = hash_combine((uint32) varno, (uint32) attno);
+	hash = hash_combine(hash, (uint32) levelsup);
+
+	return (int) (hash % PROOF_SIGNATURE_BITS);
+}
+/** modification end **/
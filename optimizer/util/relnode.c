@@ -30,6 +30,10 @@
 #include "optimizer/tlist.h"
 #include "utils/hsearch.h"
 #include "utils/lsyscache.h"
+/** modification start **/
+#include "anchor2struct.h"
+#include "optimizer/pilotscope_paths.h"
+/** modification end **/
 
 
 typedef struct JoinHashEntry
@@ -38,6 +42,49 @@ typedef struct JoinHashEntry
 	RelOptInfo *join_rel;
 } JoinHashEntry;
 
+/** modification start **/
+/*
+ * Open-addressing table of the join rels of one PlannerInfo, keyed by their
+ * relids as a bitmask (bit relid - 1).  find_join_rel uses it instead of
+ * join_rel_list and join_rel_hash when no RT index exceeds
+ * JOIN_REL_MASK_MAX_RELID, from the first join rel on.
+ *
+ * The table indexes the first nentries members of join_rel_list and catches
+ * up with the list lazily, so join rels added by code that doesn't know of
+ * it (e.g. GEQO of the server) are found as well.  If the list was truncated
+ * under it, it is rebuilt.
+ */
+#define JOIN_REL_MASK_MAX_RELID 64
+
+typedef struct JoinRelMaskEntry
+{
+	uint64		mask;			/* 0 for an empty slot */
+	RelOptInfo *join_rel;
+} JoinRelMaskEntry;
+
+typedef struct JoinRelMaskTable
+{
+	PlannerInfo *root;
+	int			size;			/* number of slots, a power of 2 */
+	int			nused;			/* number of used slots */
+	int			nentries;		/* number of join_rel_list members indexed */
+	RelOptInfo *last_rel;		/* join_rel_list member nentries - 1 */
+	JoinRelMaskEntry *slots;
+} JoinRelMaskTable;
+
+/* The tables of the current planning cycle, one per PlannerInfo */
+static List *join_rel_mask_tables = NIL;
+static int	join_rel_mask_tables_cycle = 0;
+static JoinRelMaskTable *last_join_rel_mask_table = NULL;
+
+static JoinRelMaskTable *get_join_rel_mask_table(PlannerInfo *root);
+static void sync_join_rel_mask_table(JoinRelMaskTable *table);
+static void insert_join_rel_mask(JoinRelMaskTable *table, uint64 mask,
+								 RelOptInfo *join_rel);
+static RelOptInfo *lookup_join_rel_mask(JoinRelMaskTable *table, uint64 mask);
+static uint64 relids_to_join_rel_mask(Relids relids);
+/** modification end **/
+
 static void build_joinrel_tlist(PlannerInfo *root, RelOptInfo *joinrel,
 								RelOptInfo *input_rel);
 static List *build_joinrel_restrictlist(PlannerInfo *root,
@@ -438,6 +485,13 @@ build_join_rel_hash(PlannerInfo *root)
 RelOptInfo *
 find_join_rel(PlannerInfo *root, Relids relids)
 {
+	/** modification start **/
+	JoinRelMaskTable *table = get_join_rel_mask_table(root);
+
+	if (table != NULL)
+		return lookup_join_rel_mask(table, relids_to_join_rel_mask(relids));
+	/** modification end **/
+
 	/*
 	 * Switch to using hash lookup when list grows "too long".  The threshold
 	 * is arbitrary and is known only here.
@@ -481,6 +535,219 @@ find_join_rel(PlannerInfo *root, Relids relids)
 	return NULL;
 }
 
+/** modification start **/
+/*
+ * get_join_rel_mask_table
+ *	  Returns the join rel table of the given PlannerInfo, brought up to date
+ *	  with its join_rel_list, or NULL if the relids don't fit in a bitmask.
+ */
+static JoinRelMaskTable *
+get_join_rel_mask_table(PlannerInfo *root)
+{
+	JoinRelMaskTable *table = NULL;
+	ListCell   *lc;
+
+	if (root->simple_rel_array_size > JOIN_REL_MASK_MAX_RELID + 1)
+		return NULL;
+
+	/* The tables of former planning cycles are gone with their contexts */
+	if (join_rel_mask_tables_cycle != planning_cycle)
+	{
+		join_rel_mask_tables = NIL;
+		join_rel_mask_tables_cycle = planning_cycle;
+		last_join_rel_mask_table = NULL;
+	}
+
+	if (last_join_rel_mask_table != NULL &&
+		last_join_rel_mask_table->root == root)
+		table = last_join_rel_mask_table;
+	else
+	{
+		foreach(lc, join_rel_mask_tables)
+		{
+			JoinRelMaskTable *candidate = (JoinRelMaskTable *) lfirst(lc);
+
+			if (candidate->root == root)
+			{
+				table = candidate;
+				break;
+			}
+		}
+	}
+
+	if (table == NULL)
+	{
+		MemoryContext oldcxt = MemoryContextSwitchTo(root->planner_cxt);
+
+		table = (JoinRelMaskTable *) palloc0(sizeof(JoinRelMaskTable));
+		table->root = root;
+		table->size = 64;
+		table->slots = (JoinRelMaskEntry *)
+			palloc0(table->size * sizeof(JoinRelMaskEntry));
+		join_rel_mask_tables = lappend(join_rel_mask_tables, table);
+
+		MemoryContextSwitchTo(oldcxt);
+	}
+
+	last_join_rel_mask_table = table;
+	sync_join_rel_mask_table(table);
+
+	return table;
+}
+
+/*
+ * sync_join_rel_mask_table
+ *	  Index the members of join_rel_list added since the last call.
+ */
+static void
+sync_join_rel_mask_table(JoinRelMaskTable *table)
+{
+	List	   *join_rel_list = table->root->join_rel_list;
+	int			length = list_length(join_rel_list);
+
+	if (length < table->nentries ||
+		(table->nentries > 0 &&
+		 list_nth(join_rel_list, table->nentries - 1) != table->last_rel))
+		reset_join_rel_mask_table(table->root);
+
+	while (table->nentries < length)
+	{
+		RelOptInfo *rel = (RelOptInfo *) list_nth(join_rel_list,
+												  table->nentries);
+
+		insert_join_rel_mask(table, relids_to_join_rel_mask(rel->relids), rel);
+		table->nentries++;
+		table->last_rel = rel;
+	}
+}
+
+/*
+ * reset_join_rel_mask_table
+ *	  Forget the join rels indexed for the given PlannerInfo.
+ *
+ * For callers that truncate join_rel_list; the table would notice most
+ * truncations by itself, but not one that was followed by new join rels.
+ */
+void
+reset_join_rel_mask_table(PlannerInfo *root)
+{
+	JoinRelMaskTable *table = last_join_rel_mask_table;
+
+	if (join_rel_mask_tables_cycle != planning_cycle)
+		return;
+
+	if (table == NULL || table->root != root)
+	{
+		ListCell   *lc;
+
+		table = NULL;
+		foreach(lc, join_rel_mask_tables)
+		{
+			if (((JoinRelMaskTable *) lfirst(lc))->root == root)
+			{
+				table = (JoinRelMaskTable *) lfirst(lc);
+				break;
+			}
+		}
+		if (table == NULL)
+			return;
+	}
+
+	MemSet(table->slots, 0, table->size * sizeof(JoinRelMaskEntry));
+	table->nused = 0;
+	table->nentries = 0;
+	table->last_rel = NULL;
+}
+
+#define JOIN_REL_MASK_SLOT(mask, size) \
+	((int) (((mask) * UINT64CONST(0x9E3779B97F4A7C15)) >> 32) & ((size) - 1))
+
+/*
+ * insert_join_rel_mask
+ *	  Add a join rel to the table, growing it to stay at most half full.  As
+ *	  with the linear search, the first join rel of a relids set wins.
+ */
+static void
+insert_join_rel_mask(JoinRelMaskTable *table, uint64 mask,
+					 RelOptInfo *join_rel)
+{
+	int			i;
+
+	if ((table->nused + 1) * 2 > table->size)
+	{
+		JoinRelMaskEntry *oldslots = table->slots;
+		int			oldsize = table->size;
+
+		table->size = oldsize * 2;
+		table->slots = (JoinRelMaskEntry *)
+			MemoryContextAllocZero(table->root->planner_cxt,
+								   table->size * sizeof(JoinRelMaskEntry));
+		for (i = 0; i < oldsize; i++)
+		{
+			int			j;
+
+			if (oldslots[i].mask == 0)
+				continue;
+			j = JOIN_REL_MASK_SLOT(oldslots[i].mask, table->size);
+			while (table->slots[j].mask != 0)
+				j = (j + 1) & (table->size - 1);
+			table->slots[j] = oldslots[i];
+		}
+		pfree(oldslots);
+	}
+
+	i = JOIN_REL_MASK_SLOT(mask, table->size);
+	while (table->slots[i].mask != 0)
+	{
+		if (table->slots[i].mask == mask)
+			return;
+		i = (i + 1) & (table->size - 1);
+	}
+	table->slots[i].mask = mask;
+	table->slots[i].join_rel = join_rel;
+	table->nused++;
+}
+
+/*
+ * lookup_join_rel_mask
+ *	  Returns the join rel of the given relids bitmask, or NULL.
+ */
+static RelOptInfo *
+lookup_join_rel_mask(JoinRelMaskTable *table, uint64 mask)
+{
+	int			i = JOIN_REL_MASK_SLOT(mask, table->size);
+
+	while (table->slots[i].mask != 0)
+	{
+		if (table->slots[i].mask == mask)
+			return table->slots[i].join_rel;
+		i = (i + 1) & (table->size - 1);
+	}
+
+	return NULL;
+}
+
+/*
+ * relids_to_join_rel_mask
+ *	  Convert relids to the bitmask key of the join rel table.  The caller has
+ *	  checked that all of them fit.
+ */
+static uint64
+relids_to_join_rel_mask(Relids relids)
+{
+	uint64		mask = 0;
+	int			relid = -1;
+
+	while ((relid = bms_next_member(relids, relid)) >= 0)
+	{
+		Assert(relid >= 1 && relid <= JOIN_REL_MASK_MAX_RELID);
+		mask |= UINT64CONST(1) << (relid - 1);
+	}
+
+	return mask;
+}
+/** modification end **/
+
 /*
  * set_foreign_rel_properties
  *		Set up foreign-join fields if outer and inner relation are foreign
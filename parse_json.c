@@ -57,13 +57,13 @@
  * -------------------------------------------------------------------------
  */
 
+#include "postgres.h"
 #include<stdio.h>
 #include "utils/cJSON.h"
 #include "utils/cson.h"
 #include "anchor2struct.h"
 #include "send_and_receive.h"
 #include "time.h"
-#include "postgres.h"
 #include "utils/pilotscope_config.h"
 #include "utils/utils.h"
 
@@ -165,6 +165,10 @@ static void parse_one_anchor(char* anchorname,char* anchor_json)
             anchor_handler(anchor_json,card_replace_anchor,CardReplaceAnchor,Card_Replace_Anchor_ref_tbl);
             store_aimodel_subquery2card();
             break;
+        case SELECTIVITY_REPLACE_ANCHOR:
+            anchor_handler(anchor_json,selectivity_replace_anchor,SelectivityReplaceAnchor,Selectivity_Replace_Anchor_ref_tbl);
+            store_aimodel_clause2selectivity();
+            break;
         case EXECUTION_TIME_FETCH_ANCHOR:
             anchor_handler(anchor_json,execution_time_fetch_anchor,ExecutionTimeFetchAnchor,Execution_Time_Fetch_Anchor_ref_tbl);
             break;
@@ -197,7 +201,7 @@ static cJSON* parse_relative_infomation(char* queryString,char* check_start,char
 
     // get json
     int  len_of_anchor_dict     = end-start+1;
-    char *string_of_anchor_dict = (char *)palloc((len_of_anchor_dict+1) * sizeof(char));
+    char *string_of_anchor_dict = (char *)MemoryContextAllocZero(PilotScopeQueryContext,(len_of_anchor_dict+1) * sizeof(char));
     strncpy(string_of_anchor_dict,start,len_of_anchor_dict);
     cJSON* anchor_dict = cJSON_Parse(string_of_anchor_dict);
 
@@ -220,14 +224,14 @@ static cJSON* parse_relative_infomation(char* queryString,char* check_start,char
     else
     {
         port = port_item->valueint;
-        host = (char*)palloc(CHAR_LEN_FOR_NUM*sizeof(char));
+        host = (char*)MemoryContextAlloc(PilotScopeQueryContext,CHAR_LEN_FOR_NUM*sizeof(char));
         strcpy(host,url_item->valuestring);
     }
 
     // tid
     if(tid_item != NULL)
     {
-        pilot_transdata->tid = (char*)palloc(CHAR_LEN_FOR_NUM*sizeof(char));
+        pilot_transdata->tid = (char*)MemoryContextAlloc(PilotScopeQueryContext,CHAR_LEN_FOR_NUM*sizeof(char));
         strcpy(pilot_transdata->tid,tid_item->valuestring);
     }
 
@@ -8,10 +8,13 @@
  *      planner_hook ---> pilotscope_hook_planner
  *      ExecutorStart_hook ---> pilotscope_hook_ExecutorStart
  *      ExecutorEnd_hook ---> pilotscope_hook_ExecutorEnd
+ *      shmem_startup_hook ---> cost_provider_shmem_startup (see "utils/cost_provider.c")
+ *      xact callback ---> pilotscope_xact_callback (see "anchor2struct.c")
  * 
  * Anchors:
  *      subquery_card_fetcher_anchor
  *      card_replace_anchor
+ *      selectivity_replace_anchor
  *      execution_time_fetch_anchor
  *      record_fetch_anchor
  * 
@@ -71,11 +74,14 @@ PG_MODULE_MAGIC;
 #include "time.h"
 #include "utils/pilotscope_config.h"
 #include "utils/utils.h"
+#include "utils/pilotscope_guc.h"
+#include "utils/cost_provider.h"
 
 /*
  * When postgres starts, it will go through _PG_init and the global
  * hooks will be changed into ours. In addition, we will store the previous
- * hooks in case of future incremental codes. After the life cycle, it will
+ * hooks in case of future incremental codes, define the GUCs of pilotscope and create PilotScopeQueryContext
+ * (see "anchor2struct.c"). After the life cycle, it will
  * arrive at _PG_fini to  finish pilotscope.
  */
 void _PG_init(void);
@@ -111,6 +117,9 @@ void _PG_init(void)
     prev_planner_hook       = planner_hook;
     prev_ExecutorEnd_hook   = ExecutorEnd_hook;
     prev_ExecutorStart_hook = ExecutorStart_hook;
+    define_pilotscope_gucs();
+    init_cost_provider();
+    init_pilotscope_query_context();
     activate_hooks();
     elog(INFO, "pilotscope extension loaded.");
 }
@@ -163,6 +172,7 @@ static PlannedStmt* pilotscope_hook_planner(Query* parse, const char* queryStrin
          * and card_replace_anchor. It is worth noting that pilotscope_standard_planner is a little different
          * from the standard_planner. Since we dig out the 'optimizer' part from pg source codes and put it in
          * our work path. Then we modify some codes in 'costsize.c' in order to process the above two anchors.
+         * The selectivity_replace_anchor is processed in 'clausesel.c' in the same way.
          * Some reseachers and enigineers may be confused why we do not directly modify source codes of pg.
          * The reason is that the naive method seems like convinent but will break the aim
          * of 'plug and play' because users may be forced to modify the pg source themselves.
@@ -189,6 +199,15 @@ static PlannedStmt* pilotscope_hook_planner(Query* parse, const char* queryStrin
                 add_anchor_time(card_replace_anchor->name,cardreplace_time);
             }
 
+            if(selectivity_replace_anchor != NULL && selectivity_replace_anchor->enable == 1)
+            { 
+                elog(INFO,"selectivity_replace_anchor done!");
+                change_flag_for_anchor(selectivity_replace_anchor->enable);
+
+                // add anchor time
+                add_anchor_time(selectivity_replace_anchor->name,selectivityreplace_time);
+            }
+
             if(subquery_card_fetcher_anchor != NULL && subquery_card_fetcher_anchor->enable == 1)
             { 
                 elog(INFO,"The number of subqueries is %d",pilot_transdata->subquery_num);
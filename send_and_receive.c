@@ -49,7 +49,7 @@
  * -------------------------------------------------------------------------
  */
 
-#include <stdbool.h>
+#include "postgres.h"
 #include "utils/http.h"
 #include "anchor2struct.h"
 #include <netinet/in.h>
@@ -63,7 +63,6 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
-#include "postgres.h"
 #include "utils/pilotscope_config.h"
 
 /*
@@ -73,6 +72,21 @@
  */
 int send_and_receive(char* string_of_pilottransdata)
 {
+	return send_and_receive_with_response(string_of_pilottransdata, NULL);
+}
+
+/*
+ * The same as send_and_receive, but also keep the body of the response in *response if
+ * response isn't NULL. The body is in PilotScopeQueryContext, and *response stays NULL unless the python
+ * side answered with status code 200.
+ */
+int send_and_receive_with_response(char* string_of_pilottransdata, char** response)
+{
+	if(response != NULL)
+	{
+		*response = NULL;
+	}
+
    /*
 	* Create http connection here. We will recreate it if failed as if 
 	* the time is no more than MAX_SEND_TIMES. Otherwise, we will just report
@@ -98,11 +112,13 @@ int send_and_receive(char* string_of_pilottransdata)
 	* WAITE_TIME if the send time is no more than MAX_SEND_TIMES. Otherwise, we will 
 	* report failure information and just return. If it successfully received the data, 
 	* we will shut down the socket in case of two many socket connections occupied in 
-	* the system resources.
+	* the system resources. The socket is closed in any case, since we connect again
+	* for each exchange.
 	*/
 	
 	// send
 	int send_times = 1;
+	int result = 1;
 	send_data(&t_client, string_of_pilottransdata);
 
 	// receive、resend
@@ -122,7 +138,8 @@ int send_and_receive(char* string_of_pilottransdata)
 		if(send_times == MAX_SEND_TIMES)
 		{
 			elog(INFO,"Reach the maximum number of sending times!");
-			return 0;
+			result = 0;
+			break;
 		}
 
 		// add socket which needs to be listened to rset
@@ -148,9 +165,8 @@ int send_and_receive(char* string_of_pilottransdata)
 		// there is data in socket if file description socket in file description set is set to 1
 		if (FD_ISSET(sockfd, &rset)) 
 		{				
-			char* response;
 			// try to receive data
-			n = recv_data(&t_client,string_of_pilottransdata,&response);
+			n = recv_data(&t_client,string_of_pilottransdata,response);
 
 			// failed to receive if n<0 otherwise succeed
 			if (n < 0) 
@@ -194,5 +210,6 @@ int send_and_receive(char* string_of_pilottransdata)
 		}
 	}
 
-	return 1;
+	close(t_client.socket);
+	return result;
 }
\ No newline at end of file
@@ -11,4 +11,5 @@
 #define __SEND_AND_RECEIVE__
 
 extern int send_and_receive(char* string_of_pilottransdata);
+extern int send_and_receive_with_response(char* string_of_pilottransdata, char** response);
 #endif 
\ No newline at end of file
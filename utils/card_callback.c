@@ -0,0 +1,304 @@
+/*-------------------------------------------------------------------------
+ *
+ * card_callback.c
+ *	  Routines to ask the python side for cardinalities while planning.
+ *
+ * A batch collects the subqueries whose cardinalities are unknown, while the
+ * rels they belong to get the estimates of pg for now. At the end of the
+ * batch, they are sent to the python side in one request over the same
+ * connection as the data of end_anchor (see "send_and_receive.c"):
+ *
+ *      {"tid": "1234", "callback": "card", "subquery": ["select count(*) from ...", ...]}
+ *
+ * and the answer holds the cardinalities in the same order, as numbers or
+ * strings like the card of card_replace_anchor:
+ *
+ *      {"card": [174305.0, 3157.472, ...]}
+ *
+ * The rows of the rels of the batch are then set to the answers. Subqueries
+ * asked for once are never asked for again in the same planning cycle, and a
+ * failed request leaves the estimates of pg in place. After a failed request,
+ * we don't ask again for the rest of the planning cycle, so that planning
+ * doesn't wait for a python side that is gone once per level of the join search.
+ *
+ * Only the planning of the query with the json prefix asks; the batch of a
+ * nested planning, e.g. of a function evaluated during the planning, starts
+ * a new planning cycle and so drops the subqueries collected so far.
+ *
+ * Copyright (c) 2023, Damo Academy of Alibaba Group
+ * -------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/hashfn.h"
+#include "optimizer/optimizer.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+#include "cJSON.h"
+#include "pilotscope_guc.h"
+#include "card_callback.h"
+#include "../anchor2struct.h"
+#include "../send_and_receive.h"
+
+// the cardinality of one subquery
+typedef struct
+{
+    const char* key;    // hash key, MUST BE FIRST
+    bool has_card;
+    double card;
+}CardCallbackEntry;
+
+// a rel of the batch whose rows wait for the answer
+typedef struct
+{
+    double* rows;
+    CardCallbackEntry* entry;
+}CardCallbackTarget;
+
+static int card_callback_cycle = -1;
+static HTAB* card_callback_entries = NULL;
+
+// the planning cycle in which a request failed, if any
+static int card_callback_failed_cycle = -1;
+
+// the batch being collected, if batch_owner isn't NULL
+static const void* batch_owner = NULL;
+static CardCallbackEntry** batch_entries = NULL;
+static int batch_nentries = 0;
+static int batch_maxentries = 0;
+static CardCallbackTarget* batch_targets = NULL;
+static int batch_ntargets = 0;
+static int batch_maxtargets = 0;
+
+static void check_card_callback_cycle();
+static uint32 card_callback_key_hash(const void* key, Size keysize);
+static int card_callback_key_match(const void* key1, const void* key2, Size keysize);
+static void send_card_callback_batch();
+
+// hash the string a key points to
+static uint32 card_callback_key_hash(const void* key, Size keysize)
+{
+    const char* s = *(const char* const*) key;
+
+    return hash_bytes((const unsigned char*) s, strlen(s));
+}
+
+// compare the strings two keys point to
+static int card_callback_key_match(const void* key1, const void* key2, Size keysize)
+{
+    return strcmp(*(const char* const*) key1, *(const char* const*) key2);
+}
+
+// forget the cardinalities and the batch of former planning cycles. Everything is
+// allocated in PilotScopeQueryContext, which the next annotated query resets.
+static void check_card_callback_cycle()
+{
+    HASHCTL hash_ctl;
+
+    if (card_callback_entries != NULL && card_callback_cycle == planning_cycle)
+    {
+        return;
+    }
+
+    MemSet(&hash_ctl, 0, sizeof(hash_ctl));
+    hash_ctl.keysize = sizeof(const char*);
+    hash_ctl.entrysize = sizeof(CardCallbackEntry);
+    hash_ctl.hash = card_callback_key_hash;
+    hash_ctl.match = card_callback_key_match;
+    hash_ctl.hcxt = PilotScopeQueryContext;
+    card_callback_entries = hash_create("Card callback entries", 256, &hash_ctl,
+                                        HASH_ELEM | HASH_FUNCTION | HASH_COMPARE | HASH_CONTEXT);
+    card_callback_cycle = planning_cycle;
+
+    batch_owner = NULL;
+    batch_entries = NULL;
+    batch_nentries = 0;
+    batch_maxentries = 0;
+    batch_targets = NULL;
+    batch_ntargets = 0;
+    batch_maxtargets = 0;
+}
+
+// whether this planning asks the python side for cardinalities
+bool card_callback_active()
+{
+    return enable_card_callback && enablePilotscope == 1 && anchor_num > 0 &&
+           host != NULL && pilot_transdata != NULL && pilot_transdata->tid != NULL &&
+           card_callback_failed_cycle != planning_cycle;
+}
+
+// start a batch for owner. Return false if another batch is being collected.
+bool card_callback_begin(const void* owner)
+{
+    check_card_callback_cycle();
+    if (batch_owner != NULL)
+    {
+        return false;
+    }
+    batch_owner = owner;
+    return true;
+}
+
+/*
+ * Return the cardinality of the subquery key if we know it, else pg_rows. If the
+ * batch of owner is being collected and rows isn't NULL, an unknown key is added
+ * to the batch and *rows is set to its cardinality at the end of the batch.
+ */
+double card_callback_rows(const void* owner, const char* key, double* rows, double pg_rows)
+{
+    CardCallbackEntry* entry;
+    bool found;
+
+    check_card_callback_cycle();
+
+    entry = (CardCallbackEntry*) hash_search(card_callback_entries, &key, HASH_FIND, NULL);
+    if (entry != NULL && entry->has_card)
+    {
+        return entry->card;
+    }
+
+    if (batch_owner == NULL || batch_owner != owner || rows == NULL)
+    {
+        return pg_rows;
+    }
+
+    if (entry == NULL)
+    {
+        entry = (CardCallbackEntry*) hash_search(card_callback_entries, &key, HASH_ENTER, &found);
+        entry->key = MemoryContextStrdup(PilotScopeQueryContext, key);
+        entry->has_card = false;
+        entry->card = 0;
+
+        if (batch_nentries == batch_maxentries)
+        {
+            batch_maxentries = batch_maxentries == 0 ? 64 : batch_maxentries * 2;
+            batch_entries = batch_entries == NULL ?
+                (CardCallbackEntry**) MemoryContextAlloc(PilotScopeQueryContext,
+                                                         batch_maxentries * sizeof(CardCallbackEntry*)) :
+                (CardCallbackEntry**) repalloc(batch_entries, batch_maxentries * sizeof(CardCallbackEntry*));
+        }
+        batch_entries[batch_nentries++] = entry;
+    }
+
+    if (batch_ntargets == batch_maxtargets)
+    {
+        batch_maxtargets = batch_maxtargets == 0 ? 64 : batch_maxtargets * 2;
+        batch_targets = batch_targets == NULL ?
+            (CardCallbackTarget*) MemoryContextAlloc(PilotScopeQueryContext,
+                                                     batch_maxtargets * sizeof(CardCallbackTarget)) :
+            (CardCallbackTarget*) repalloc(batch_targets, batch_maxtargets * sizeof(CardCallbackTarget));
+    }
+    batch_targets[batch_ntargets].rows = rows;
+    batch_targets[batch_ntargets].entry = entry;
+    batch_ntargets++;
+
+    return pg_rows;
+}
+
+// send the subqueries of the batch and store the cardinalities of the answer. If
+// there is no valid answer, the callback is off for the rest of the planning cycle.
+static void send_card_callback_batch()
+{
+    cJSON* request;
+    cJSON* subqueries;
+    cJSON* answer;
+    cJSON* cards;
+    char* json;
+    char* response = NULL;
+    bool ok = true;
+    int i;
+
+    request = cJSON_CreateObject();
+    cJSON_AddStringToObject(request, "tid", pilot_transdata->tid);
+    cJSON_AddStringToObject(request, "callback", "card");
+    subqueries = cJSON_CreateArray();
+    for (i = 0; i < batch_nentries; i++)
+    {
+        cJSON_AddItemToArray(subqueries, cJSON_CreateString(batch_entries[i]->key));
+    }
+    cJSON_AddItemToObject(request, "subquery", subqueries);
+    json = cJSON_PrintUnformatted(request);
+    cJSON_Delete(request);
+
+    send_and_receive_with_response(json, &response);
+    cJSON_free(json);
+
+    if (response == NULL)
+    {
+        ereport(WARNING,
+                (errmsg("pilotscope: no answer to the cardinality callback of %d subqueries", batch_nentries)));
+        card_callback_failed_cycle = planning_cycle;
+        return;
+    }
+
+    answer = cJSON_Parse(response);
+    pfree(response);
+    cards = answer == NULL ? NULL : cJSON_GetObjectItem(answer, "card");
+    if (cards == NULL || !cJSON_IsArray(cards) || cJSON_GetArraySize(cards) != batch_nentries)
+    {
+        ereport(WARNING,
+                (errmsg("pilotscope: invalid answer to the cardinality callback of %d subqueries", batch_nentries)));
+        cJSON_Delete(answer);
+        card_callback_failed_cycle = planning_cycle;
+        return;
+    }
+
+    for (i = 0; i < batch_nentries; i++)
+    {
+        cJSON* card = cJSON_GetArrayItem(cards, i);
+
+        if (cJSON_IsNumber(card))
+        {
+            batch_entries[i]->card = card->valuedouble;
+        }
+        else if (cJSON_IsString(card))
+        {
+            batch_entries[i]->card = atof(card->valuestring);
+        }
+        else
+        {
+            ok = false;
+            continue;
+        }
+        batch_entries[i]->has_card = true;
+    }
+    cJSON_Delete(answer);
+
+    if (!ok)
+    {
+        ereport(WARNING,
+                (errmsg("pilotscope: invalid cardinalities in the answer to the cardinality callback")));
+    }
+}
+
+// end the batch of owner: ask for its subqueries and set the rows of its rels
+void card_callback_end(const void* owner)
+{
+    int i;
+
+    check_card_callback_cycle();
+    if (batch_owner == NULL || batch_owner != owner)
+    {
+        return;
+    }
+    batch_owner = NULL;
+
+    if (batch_nentries > 0)
+    {
+        send_card_callback_batch();
+        for (i = 0; i < batch_ntargets; i++)
+        {
+            if (batch_targets[i].entry->has_card)
+            {
+                *batch_targets[i].rows = clamp_row_est(batch_targets[i].entry->card);
+            }
+        }
+    }
+
+    batch_nentries = 0;
+    batch_ntargets = 0;
+}
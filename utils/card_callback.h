@@ -0,0 +1,28 @@
+/*-------------------------------------------------------------------------
+ *
+ * card_callback.h
+ *	  prototypes for card_callback.c.
+ *
+ * With pilotscope.enable_card_callback on, the planner asks the python side
+ * for the cardinalities of the subqueries while planning, instead of fetching
+ * them with subquery_card_fetcher_anchor and submitting the query again with
+ * card_replace_anchor. make_one_rel and standard_join_search in
+ * "optimizer/path/allpaths.c" collect the subqueries of the base rels and of
+ * each level of the join search; the size estimates in
+ * "optimizer/path/costsize.c" use the answers.
+ *
+ * Copyright (c) 2023, Damo Academy of Alibaba Group
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef __CARD_CALLBACK__
+#define __CARD_CALLBACK__
+
+// function
+extern bool card_callback_active();
+extern bool card_callback_begin(const void* owner);
+extern double card_callback_rows(const void* owner, const char* key, double* rows, double pg_rows);
+extern void card_callback_end(const void* owner);
+
+#endif
@@ -0,0 +1,251 @@
+/*-------------------------------------------------------------------------
+ *
+ * card_model.c
+ *	  Routines to estimate cardinalities with a gradient-boosted tree model.
+ *
+ * The model is read from pilotscope.card_model_file by each backend when it
+ * is first needed, and again whenever the setting changes. The file is text
+ * holding the flat arrays of the trees:
+ *
+ *      gbdt <nfeatures> <ntrees> <nnodes> <base score>
+ *      root <root node>                                 one line per tree
+ *      <feature> <threshold> <left> <right> <value>     one line per node
+ *
+ * A node with a negative feature is a leaf, whose value is added to the
+ * score; any other node goes on with its left child if the feature is below
+ * the threshold and with its right child otherwise. The children of a node
+ * must come after it, so that every walk ends. nfeatures must be the number
+ * of features of card_model.h. The score is the natural log of the rows.
+ * Blank lines and lines starting with '#' are skipped.
+ *
+ * Copyright (c) 2023, Damo Academy of Alibaba Group
+ * -------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "storage/fd.h"
+#include "utils/memutils.h"
+#include "pilotscope_guc.h"
+#include "card_model.h"
+
+// the largest score we take, e^100 rows being plenty
+#define MAX_CARD_MODEL_SCORE 100.0
+
+// the trees of the model as flat arrays indexed by node
+typedef struct
+{
+    int ntrees;
+    int nnodes;
+    double base_score;
+    int* roots;
+    int* feature;
+    double* threshold;
+    int* left;
+    int* right;
+    double* value;
+}CardModel;
+
+static MemoryContext card_model_context = NULL;
+static CardModel* card_model = NULL;
+static char* card_model_loaded_file = NULL;
+
+static CardModel* get_card_model();
+static CardModel* load_card_model(const char* filename);
+static bool read_model_line(FILE* file, char* line, int size, int* lineno);
+
+// read the next line that is neither blank nor a comment
+static bool read_model_line(FILE* file, char* line, int size, int* lineno)
+{
+    while (fgets(line, size, file) != NULL)
+    {
+        char* p = line;
+
+        (*lineno)++;
+        while (*p == ' ' || *p == '\t')
+        {
+            p++;
+        }
+        if (*p != '\0' && *p != '\n' && *p != '\r' && *p != '#')
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// read the model of filename into card_model_context, or return NULL and
+// report why if the file is unusable
+static CardModel* load_card_model(const char* filename)
+{
+    FILE* file;
+    char line[1024];
+    int lineno = 0;
+    int nfeatures;
+    CardModel* model;
+    const char* error = NULL;
+    int i;
+
+    file = AllocateFile(filename, "r");
+    if (file == NULL)
+    {
+        ereport(WARNING,
+                (errcode_for_file_access(),
+                 errmsg("pilotscope: could not open cardinality model file \"%s\": %m", filename)));
+        return NULL;
+    }
+
+    model = (CardModel*) MemoryContextAllocZero(card_model_context, sizeof(CardModel));
+    if (!read_model_line(file, line, sizeof(line), &lineno) ||
+        sscanf(line, "gbdt %d %d %d %lf", &nfeatures, &model->ntrees, &model->nnodes, &model->base_score) != 4)
+    {
+        error = "bad header";
+    }
+    else if (nfeatures != NUM_CARD_FEATURES)
+    {
+        error = "wrong number of features";
+    }
+    else if (!isfinite(model->base_score))
+    {
+        error = "bad base score";
+    }
+    else if (model->ntrees < 0 || model->nnodes < model->ntrees || model->nnodes >= MaxAllocSize / sizeof(double))
+    {
+        error = "bad number of trees or nodes";
+    }
+
+    if (error == NULL)
+    {
+        model->roots = (int*) MemoryContextAlloc(card_model_context, (model->ntrees + 1) * sizeof(int));
+        model->feature = (int*) MemoryContextAlloc(card_model_context, (model->nnodes + 1) * sizeof(int));
+        model->threshold = (double*) MemoryContextAlloc(card_model_context, (model->nnodes + 1) * sizeof(double));
+        model->left = (int*) MemoryContextAlloc(card_model_context, (model->nnodes + 1) * sizeof(int));
+        model->right = (int*) MemoryContextAlloc(card_model_context, (model->nnodes + 1) * sizeof(int));
+        model->value = (double*) MemoryContextAlloc(card_model_context, (model->nnodes + 1) * sizeof(double));
+
+        for (i = 0; i < model->ntrees && error == NULL; i++)
+        {
+            if (!read_model_line(file, line, sizeof(line), &lineno) ||
+                sscanf(line, " root %d", &model->roots[i]) != 1 ||
+                model->roots[i] < 0 || model->roots[i] >= model->nnodes)
+            {
+                error = "bad root";
+            }
+        }
+    }
+
+    for (i = 0; error == NULL && i < model->nnodes; i++)
+    {
+        if (!read_model_line(file, line, sizeof(line), &lineno) ||
+            sscanf(line, "%d %lf %d %d %lf", &model->feature[i], &model->threshold[i],
+                   &model->left[i], &model->right[i], &model->value[i]) != 5)
+        {
+            error = "bad node";
+        }
+        else if (!isfinite(model->threshold[i]) || !isfinite(model->value[i]))
+        {
+            // nan or inf would make nan rows, which clamp_row_est lets through
+            error = "bad threshold or value";
+        }
+        else if (model->feature[i] >= NUM_CARD_FEATURES ||
+                 (model->feature[i] >= 0 &&
+                  (model->left[i] <= i || model->left[i] >= model->nnodes ||
+                   model->right[i] <= i || model->right[i] >= model->nnodes)))
+        {
+            error = "bad feature or children";
+        }
+    }
+
+    FreeFile(file);
+
+    if (error != NULL)
+    {
+        ereport(WARNING,
+                (errmsg("pilotscope: invalid cardinality model file \"%s\": %s near line %d",
+                        filename, error, lineno)));
+        return NULL;
+    }
+    return model;
+}
+
+// get the model of pilotscope.card_model_file, loading it if the setting changed
+static CardModel* get_card_model()
+{
+    bool no_file = card_model_file == NULL || card_model_file[0] == '\0';
+
+    if (no_file && card_model_loaded_file == NULL)
+    {
+        return NULL;
+    }
+
+    if (card_model_loaded_file != NULL && card_model_file != NULL &&
+        strcmp(card_model_loaded_file, card_model_file) == 0)
+    {
+        return card_model;
+    }
+
+    // forget the former model, even if the new file turns out bad
+    if (card_model_context == NULL)
+    {
+        card_model_context = AllocSetContextCreate(TopMemoryContext,
+                                                   "CardModel",
+                                                   ALLOCSET_DEFAULT_SIZES);
+    }
+    MemoryContextReset(card_model_context);
+    card_model = NULL;
+    card_model_loaded_file = NULL;
+
+    if (no_file)
+    {
+        return NULL;
+    }
+
+    card_model_loaded_file = MemoryContextStrdup(card_model_context, card_model_file);
+    card_model = load_card_model(card_model_file);
+    return card_model;
+}
+
+// estimate the rows for the given features into *rows. Return false if there
+// is no usable model.
+bool card_model_predict(const double* features, double* rows)
+{
+    CardModel* model = get_card_model();
+    const int* feature;
+    const double* threshold;
+    const int* left;
+    const int* right;
+    double score;
+    int t;
+
+    if (model == NULL)
+    {
+        return false;
+    }
+
+    feature = model->feature;
+    threshold = model->threshold;
+    left = model->left;
+    right = model->right;
+    score = model->base_score;
+    for (t = 0; t < model->ntrees; t++)
+    {
+        int node = model->roots[t];
+
+        while (feature[node] >= 0)
+        {
+            node = features[feature[node]] < threshold[node] ? left[node] : right[node];
+        }
+        score += model->value[node];
+    }
+
+    if (score > MAX_CARD_MODEL_SCORE)
+    {
+        score = MAX_CARD_MODEL_SCORE;
+    }
+    *rows = exp(score);
+    return true;
+}
@@ -0,0 +1,35 @@
+/*-------------------------------------------------------------------------
+ *
+ * card_model.h
+ *	  prototypes for card_model.c.
+ *
+ * A gradient-boosted tree model of the cardinalities of base and join rels,
+ * evaluated inside the backend. set_baserel_size_estimates and
+ * calc_joinrel_size_estimate in "optimizer/path/costsize.c" ask it for the
+ * rels whose cardinality card_replace_anchor doesn't give.
+ *
+ * Copyright (c) 2023, Damo Academy of Alibaba Group
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef __CARD_MODEL__
+#define __CARD_MODEL__
+
+// the features of one estimate, in this order
+typedef enum
+{
+    CARD_FEATURE_NRELS,          // number of base rels joined
+    CARD_FEATURE_RELOID,         // oid of the table of a base rel, else 0
+    CARD_FEATURE_LOG_PG_ROWS,    // log(1 + rows estimated by pg)
+    CARD_FEATURE_LOG_OUTER_ROWS, // log(1 + rows of the outer rel), log(1 + tuples) for base rels
+    CARD_FEATURE_LOG_INNER_ROWS, // log(1 + rows of the inner rel), 0 for base rels
+    CARD_FEATURE_NCLAUSES,       // number of restriction or join clauses
+    CARD_FEATURE_JOINTYPE,       // JoinType of the join, JOIN_INNER for base rels
+    NUM_CARD_FEATURES
+}CardFeature;
+
+// function
+extern bool card_model_predict(const double* features, double* rows);
+
+#endif
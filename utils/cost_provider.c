@@ -0,0 +1,336 @@
+/*-------------------------------------------------------------------------
+ *
+ * cost_provider.c
+ *	  Routines to let a model replace the costs of the costsize.c formulas.
+ *
+ * The provider installed by another extension in the rendezvous variable
+ * "pilotscope_cost_provider" is used first. Without one, we use a linear
+ * model per cost function whose weights are read from pilotscope.cost_model_file.
+ * When pilotscope is in shared_preload_libraries, the weights are loaded
+ * once at postmaster startup into shared memory; otherwise each backend
+ * loads them on first use. The file can be changed by a reload of the
+ * configuration; a backend then loads the new file on the next use, unless
+ * it is the one in shared memory.
+ *
+ * The file has one line per cost function and cost, such as
+ *
+ *      hashjoin total 0 0 1.2 0.01 0 0 0
+ *
+ * giving the weights of the features of cost_provider.h in order. The cost
+ * functions are seqscan, index, nestloop, mergejoin, hashjoin, sort and agg,
+ * and the costs startup and total. Lines starting with '#' are comments. A
+ * cost without a line keeps the value of the pg formula.
+ *
+ * Copyright (c) 2023, Damo Academy of Alibaba Group
+ * -------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "fmgr.h"
+#include "miscadmin.h"
+#include "storage/fd.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "utils/memutils.h"
+#include "pilotscope_guc.h"
+#include "cost_provider.h"
+
+// the weights of the linear model of every cost function
+typedef struct
+{
+    char file[MAXPGPATH];   // the file the weights were read from
+    bool has_op[NUM_COST_OPS];
+    double startup_weights[NUM_COST_OPS][NUM_COST_FEATURES];
+    double total_weights[NUM_COST_OPS][NUM_COST_FEATURES];
+}LinearCostModel;
+
+static const char* const cost_op_names[NUM_COST_OPS] = {
+    "seqscan",
+    "index",
+    "nestloop",
+    "mergejoin",
+    "hashjoin",
+    "sort",
+    "agg"
+};
+
+static CostProvider** cost_provider_var = NULL;
+static LinearCostModel* linear_model = NULL;
+static LinearCostModel* shared_linear_model = NULL;
+static LinearCostModel* local_linear_model = NULL;
+static bool cost_model_file_changed = true;
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+static void cost_provider_shmem_startup();
+static void load_linear_cost_model(LinearCostModel* model, const char* filename);
+static LinearCostModel* get_linear_cost_model();
+static CostProvider* get_cost_provider();
+
+// called by _PG_init after the gucs are defined
+void init_cost_provider()
+{
+    cost_provider_var = (CostProvider**) find_rendezvous_variable("pilotscope_cost_provider");
+
+    if (process_shared_preload_libraries_in_progress)
+    {
+        RequestAddinShmemSpace(MAXALIGN(sizeof(LinearCostModel)));
+        prev_shmem_startup_hook = shmem_startup_hook;
+        shmem_startup_hook = cost_provider_shmem_startup;
+    }
+}
+
+// set up the linear model in shared memory, loading it if we are the first
+static void cost_provider_shmem_startup()
+{
+    bool found;
+
+    if (prev_shmem_startup_hook)
+    {
+        prev_shmem_startup_hook();
+    }
+
+    LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+    shared_linear_model = (LinearCostModel*) ShmemInitStruct("pilotscope linear cost model",
+                                                             sizeof(LinearCostModel), &found);
+    if (!found)
+    {
+        load_linear_cost_model(shared_linear_model, cost_model_file);
+    }
+    LWLockRelease(AddinShmemInitLock);
+}
+
+// find the cost function of the given name, or -1
+static int get_cost_op(const char* name)
+{
+    int op;
+
+    for (op = 0; op < NUM_COST_OPS; op++)
+    {
+        if (strcmp(name, cost_op_names[op]) == 0)
+        {
+            return op;
+        }
+    }
+    return -1;
+}
+
+// read the weights of filename into model. Bad lines are reported and skipped,
+// so that a broken file never keeps the server from starting.
+static void load_linear_cost_model(LinearCostModel* model, const char* filename)
+{
+    FILE* file;
+    char line[1024];
+    int lineno = 0;
+    int op;
+
+    if (filename == NULL)
+    {
+        filename = "";
+    }
+
+    memset(model, 0, sizeof(LinearCostModel));
+    strlcpy(model->file, filename, MAXPGPATH);
+    for (op = 0; op < NUM_COST_OPS; op++)
+    {
+        model->startup_weights[op][COST_FEATURE_STARTUP_COST] = 1.0;
+        model->total_weights[op][COST_FEATURE_TOTAL_COST] = 1.0;
+    }
+
+    if (filename[0] == '\0')
+    {
+        return;
+    }
+
+    file = AllocateFile(filename, "r");
+    if (file == NULL)
+    {
+        ereport(WARNING,
+                (errcode_for_file_access(),
+                 errmsg("pilotscope: could not open cost model file \"%s\": %m", filename)));
+        return;
+    }
+
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        char* saveptr = NULL;
+        char* token;
+        double* weights;
+        double values[NUM_COST_FEATURES];
+        int nvalues = 0;
+        bool bad = false;
+
+        lineno++;
+        token = strtok_r(line, " \t\r\n", &saveptr);
+        if (token == NULL || token[0] == '#')
+        {
+            continue;
+        }
+
+        op = get_cost_op(token);
+        token = strtok_r(NULL, " \t\r\n", &saveptr);
+        if (op < 0 || token == NULL ||
+            (strcmp(token, "startup") != 0 && strcmp(token, "total") != 0))
+        {
+            bad = true;
+        }
+        else
+        {
+            weights = strcmp(token, "startup") == 0 ? model->startup_weights[op] : model->total_weights[op];
+            while ((token = strtok_r(NULL, " \t\r\n", &saveptr)) != NULL)
+            {
+                char* end;
+
+                if (nvalues == NUM_COST_FEATURES)
+                {
+                    bad = true;
+                    break;
+                }
+                values[nvalues++] = strtod(token, &end);
+                if (*end != '\0')
+                {
+                    bad = true;
+                    break;
+                }
+            }
+        }
+
+        if (bad || nvalues != NUM_COST_FEATURES)
+        {
+            ereport(WARNING,
+                    (errmsg("pilotscope: invalid line %d in cost model file \"%s\"", lineno, filename),
+                     errhint("Each line must name a cost function, startup or total, and %d weights.",
+                             NUM_COST_FEATURES)));
+            continue;
+        }
+
+        memcpy(weights, values, sizeof(values));
+        model->has_op[op] = true;
+    }
+
+    FreeFile(file);
+}
+
+// assign hook of pilotscope.cost_model_file: load the model again on the next use
+void assign_cost_model_file(const char* newval, void* extra)
+{
+    cost_model_file_changed = true;
+}
+
+// get the linear model of pilotscope.cost_model_file. The one in shared memory is
+// used if it was read from that file, else the file is loaded into this backend.
+static LinearCostModel* get_linear_cost_model()
+{
+    const char* file;
+
+    if (cost_model_file_changed)
+    {
+        cost_model_file_changed = false;
+        file = cost_model_file == NULL ? "" : cost_model_file;
+        if (shared_linear_model != NULL && strcmp(shared_linear_model->file, file) == 0)
+        {
+            linear_model = shared_linear_model;
+        }
+        else
+        {
+            if (local_linear_model == NULL)
+            {
+                local_linear_model = (LinearCostModel*) MemoryContextAlloc(TopMemoryContext,
+                                                                           sizeof(LinearCostModel));
+            }
+            load_linear_cost_model(local_linear_model, file);
+            linear_model = local_linear_model;
+        }
+    }
+    return linear_model;
+}
+
+// get the provider installed by another extension, if any
+static CostProvider* get_cost_provider()
+{
+    if (cost_provider_var == NULL)
+    {
+        return NULL;
+    }
+    return *cost_provider_var;
+}
+
+// whether some model replaces the costs of op
+bool cost_provider_handles(CostOp op)
+{
+    CostProvider* provider;
+    LinearCostModel* model;
+
+    if (!enable_cost_provider)
+    {
+        return false;
+    }
+
+    provider = get_cost_provider();
+    if (provider != NULL)
+    {
+        return provider->handles(op);
+    }
+
+    model = get_linear_cost_model();
+    return model != NULL && model->has_op[op];
+}
+
+// whether some model replaces the costs of any join method. The lower bounds of
+// initial_cost_nestloop and the like don't hold for the costs of a model then.
+bool cost_provider_handles_joins()
+{
+    return cost_provider_handles(COST_OP_NESTLOOP) ||
+           cost_provider_handles(COST_OP_MERGEJOIN) ||
+           cost_provider_handles(COST_OP_HASHJOIN);
+}
+
+// estimate the costs of n feature vectors of op, which cost_provider_handles(op) must accept.
+// The costs are clamped so that 0 <= startup cost <= total cost.
+void cost_provider_estimate(CostOp op, int n, const double* features,
+                            double* startup_costs, double* total_costs)
+{
+    CostProvider* provider = get_cost_provider();
+    int i;
+    int j;
+
+    if (provider != NULL)
+    {
+        provider->estimate(op, n, features, startup_costs, total_costs);
+    }
+    else
+    {
+        LinearCostModel* model = get_linear_cost_model();
+
+        for (i = 0; i < n; i++)
+        {
+            const double* f = features + i * NUM_COST_FEATURES;
+            double startup = 0;
+            double total = 0;
+
+            for (j = 0; j < NUM_COST_FEATURES; j++)
+            {
+                startup += model->startup_weights[op][j] * f[j];
+                total += model->total_weights[op][j] * f[j];
+            }
+            startup_costs[i] = startup;
+            total_costs[i] = total;
+        }
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        if (startup_costs[i] < 0)
+        {
+            startup_costs[i] = 0;
+        }
+        if (total_costs[i] < startup_costs[i])
+        {
+            total_costs[i] = startup_costs[i];
+        }
+    }
+}
@@ -0,0 +1,65 @@
+/*-------------------------------------------------------------------------
+ *
+ * cost_provider.h
+ *	  prototypes for cost_provider.c.
+ *
+ * A cost provider replaces the costs that the formulas of
+ * "optimizer/path/costsize.c" compute for some kinds of paths. Another
+ * extension installs one by storing a pointer to its CostProvider in the
+ * rendezvous variable "pilotscope_cost_provider"; otherwise the linear model
+ * of pilotscope.cost_model_file is used if pilotscope.enable_cost_provider is on.
+ *
+ * Copyright (c) 2023, Damo Academy of Alibaba Group
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef __COST_PROVIDER__
+#define __COST_PROVIDER__
+
+// the cost functions of costsize.c whose results a provider may replace
+typedef enum
+{
+    COST_OP_SEQSCAN,
+    COST_OP_INDEX,
+    COST_OP_NESTLOOP,
+    COST_OP_MERGEJOIN,
+    COST_OP_HASHJOIN,
+    COST_OP_SORT,
+    COST_OP_AGG,
+    NUM_COST_OPS
+}CostOp;
+
+// the features of one cost estimate, in this order
+typedef enum
+{
+    COST_FEATURE_BIAS,          // always 1
+    COST_FEATURE_STARTUP_COST,  // startup cost of the pg formula
+    COST_FEATURE_TOTAL_COST,    // total cost of the pg formula
+    COST_FEATURE_ROWS,          // output rows
+    COST_FEATURE_OUTER_ROWS,    // rows of the (outer) input, table tuples for scans
+    COST_FEATURE_INNER_ROWS,    // rows of the inner input of joins, else 0
+    COST_FEATURE_WIDTH,         // output width, input width for agg
+    NUM_COST_FEATURES
+}CostFeature;
+
+typedef struct
+{
+    // whether the provider has a model for op
+    bool (*handles)(CostOp op);
+
+    // estimate the costs of n feature vectors of op at once. features holds
+    // n * NUM_COST_FEATURES values; the costs go to startup_costs[i] and total_costs[i].
+    void (*estimate)(CostOp op, int n, const double* features,
+                     double* startup_costs, double* total_costs);
+}CostProvider;
+
+// function
+extern void init_cost_provider();
+extern void assign_cost_model_file(const char* newval, void* extra);
+extern bool cost_provider_handles(CostOp op);
+extern bool cost_provider_handles_joins();
+extern void cost_provider_estimate(CostOp op, int n, const double* features,
+                                   double* startup_costs, double* total_costs);
+
+#endif
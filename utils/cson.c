@@ -11,6 +11,9 @@
 
 extern cson_interface csomImpl;
 
+static void* (*cson_malloc)(size_t) = malloc;
+static void (*cson_free)(void*) = free;
+
 #define cson_object_get csomImpl.cson_object_get
 #define cson_typeof csomImpl.cson_typeof
 #define cson_loadb csomImpl.cson_loadb
@@ -392,7 +395,7 @@ int parseJsonString(cson_t jo_tmp, void* output, const reflect_item_t* tbl, int
 {
     const char* tempstr = cson_string_value(jo_tmp);
     if (NULL != tempstr) {
-        char* pDst = (char*)malloc(strlen(tempstr) + 1);
+        char* pDst = (char*)cson_malloc(strlen(tempstr) + 1);
         if (pDst == NULL) {
             return ERR_MEMORY;
         }
@@ -441,7 +444,7 @@ int parseJsonArray(cson_t jo_tmp, void* output, const reflect_item_t* tbl, int i
         return ERR_MISSING_FIELD;
     }
 
-    char* pMem = (char*)malloc(arraySize * tbl[index].arrayItemSize);
+    char* pMem = (char*)cson_malloc(arraySize * tbl[index].arrayItemSize);
     if (pMem == NULL) return ERR_MEMORY;
 
     memset(pMem, 0, arraySize * tbl[index].arrayItemSize);
@@ -471,7 +474,7 @@ int parseJsonArray(cson_t jo_tmp, void* output, const reflect_item_t* tbl, int i
 
     if (successCount == 0) {
         csonSetPropertyFast(output, &successCount, tbl + countIndex);
-        free(pMem);
+        cson_free(pMem);
         pMem = NULL;
         csonSetPropertyFast(output, &pMem, tbl + index);
         return ERR_MISSING_FIELD;
@@ -763,7 +766,7 @@ static void* freePointerSub(void* pData, const reflect_item_t* tbl)
 {
     if (tbl->type == CSON_ARRAY || tbl->type == CSON_STRING) {
         //printf("free field %s.\n", tbl->field);
-        free(*(void**)pData);
+        cson_free(*(void**)pData);
         *(void**)pData = NULL;
     }
     return NULL;
@@ -779,4 +782,10 @@ void csonFreePointer(void* list, const reflect_item_t* tbl)
 {
     /* 调用loopProperty迭代结构体中的属性,释放字符串和数组申请的内存空间 */
     csonLoopProperty(list, tbl, freePointerSub);
-}
\ No newline at end of file
+}
+
+void csonInitHooks(void* (*malloc_fn)(size_t), void (*free_fn)(void*))
+{
+    cson_malloc = malloc_fn != NULL ? malloc_fn : malloc;
+    cson_free = free_fn != NULL ? free_fn : free;
+}
@@ -276,4 +276,14 @@ void csonPrintProperty(void* pData, const reflect_item_t* tbl);
  */
 void csonFreePointer(void* list, const reflect_item_t* tbl);
 
+/**
+ * @brief Set the allocator of the strings and arrays of decoded structs
+ *
+ * @param malloc_fn: used instead of malloc, NULL for malloc.
+ * @param free_fn: used instead of free, NULL for free.
+ *
+ * @return void.
+ */
+void csonInitHooks(void* (*malloc_fn)(size_t), void (*free_fn)(void*));
+
 #endif
\ No newline at end of file
@@ -6,6 +6,10 @@
  * Note that we use the linkedlist to deal with hash conficts.
  * 
  * We use hash_bytes in the source code of pg as our hash function for convinience.
+ *
+ * Each table remembers the table_size it was created with, so that several tables
+ * of different sizes can live together. Tables live in PilotScopeQueryContext and
+ * go away with the annotated query they were built for.
  *  
  * Copyright (c) 2023, Damo Academy of Alibaba Group
  * -------------------------------------------------------------------------
@@ -14,26 +18,27 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "hashtable.h"
 #include "postgres.h"
+#include "hashtable.h"
+#include "../anchor2struct.h"
 int table_size = 1;
 Hashtable* table;
 
 static Entry* create_entry(const char* key, const char* value);
 
 // get hash
-unsigned int hash(const char* key) 
+unsigned int hash(Hashtable* table, const char* key) 
 {
     unsigned int hash_val=hash_bytes((const unsigned char*)key,strlen(key));
-    return hash_val % table_size;
+    return hash_val % table->size;
 }
 
 // create entry
 Entry* create_entry(const char* key, const char* value) 
 {
-    Entry* entry = (Entry*)malloc(sizeof(Entry));
-    entry->key   = (char*)malloc(strlen(key) + 1);
-    entry->value = (char*)malloc(strlen(value) + 1);
+    Entry* entry = (Entry*)MemoryContextAlloc(PilotScopeQueryContext, sizeof(Entry));
+    entry->key   = (char*)MemoryContextAlloc(PilotScopeQueryContext, strlen(key) + 1);
+    entry->value = (char*)MemoryContextAlloc(PilotScopeQueryContext, strlen(value) + 1);
     entry->next  = NULL;
     strcpy(entry->key, key);
     strcpy(entry->value, value);
@@ -43,15 +48,17 @@ Entry* create_entry(const char* key, const char* value)
 // create hash table
 Hashtable* create_hashtable() 
 {
-    Hashtable* table = (Hashtable*)malloc(sizeof(Hashtable));
-    table->entries   = (Entry**)calloc(table_size, sizeof(Entry*));
+    Hashtable* table = (Hashtable*)MemoryContextAlloc(PilotScopeQueryContext, sizeof(Hashtable));
+    table->size      = table_size > 0 ? table_size : 1;
+    table->entries   = (Entry**)MemoryContextAllocHuge(PilotScopeQueryContext, table->size * sizeof(Entry*));
+    memset(table->entries, 0, table->size * sizeof(Entry*));
     return table;
 }
 
 // put item into hashtable
 void put(Hashtable* table, const char* key, const char* value) 
 {
-    unsigned int index = hash(key);
+    unsigned int index = hash(table, key);
     if (table->entries[index] == NULL) 
     {
         table->entries[index] = create_entry(key, value);
@@ -77,7 +84,7 @@ void put(Hashtable* table, const char* key, const char* value)
 // get value from hashtable according to the key
 char* get(Hashtable* table, const char* key) 
 {
-    unsigned int index = hash(key);
+    unsigned int index = hash(table, key);
     Entry* current = table->entries[index];
     while (current != NULL) 
     {
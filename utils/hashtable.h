@@ -21,6 +21,7 @@ typedef struct
 typedef struct 
 {
     Entry** entries;
+    int size;
 } Hashtable;
 
 extern int table_size;
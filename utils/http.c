@@ -89,12 +89,12 @@ static int http_tcpclient_recv(http_tcpclient *pclient,char **lpbuff,int size)
 
 		if(*lpbuff == NULL)
 		{
-			*lpbuff = (char*)malloc(recvnum);
+			*lpbuff = (char*)MemoryContextAlloc(PilotScopeQueryContext,recvnum);
 
 		}
 		else
 		{
-			*lpbuff = (char*)realloc(*lpbuff,recvnum);
+			*lpbuff = (char*)repalloc(*lpbuff,recvnum);
 
 		}
 
@@ -142,6 +142,7 @@ int init_http_conn()
     if ((stt = http_tcpclient_conn(&t_client)) == -1) 
     {
 		elog(INFO, "Connect srv error.");
+		close(t_client.socket);
     }
     else
     {
@@ -167,7 +168,7 @@ int send_data(http_tcpclient *pclient,char *string_of_pilottransdata)
 	memset(h_content_len, 0, sizeof(h_content_len));
 	sprintf(h_content_len,"Content-Length: %d\r\n", strlen(string_of_pilottransdata));
 	len = strlen(h_post)+strlen(h_host)+strlen(h_header)+strlen(h_content_len)+strlen(h_content_type)+strlen(string_of_pilottransdata)+10;
-	lpbuf = (char*)palloc(len);
+	lpbuf = (char*)MemoryContextAlloc(PilotScopeQueryContext,len);
 	if(lpbuf==NULL)
 	{
 		elog(INFO,"palloc error.\n");
@@ -185,9 +186,11 @@ int send_data(http_tcpclient *pclient,char *string_of_pilottransdata)
 
 	if(http_tcpclient_send(pclient,lpbuf,len)<0)
 	{
+		pfree(lpbuf);
 		return -1;
 	}
 	
+	pfree(lpbuf);
 	return 0;
 }
 
@@ -199,15 +202,49 @@ int recv_data(http_tcpclient* pclient,char* string_of_pilottransdata,char** resp
 	char status_code[HTTP_HEADER_LENGTH];
 
 	// reveive
-	http_tcpclient_recv(pclient,&lpbuf,0);
+	len = http_tcpclient_recv(pclient,&lpbuf,0);
+	if(lpbuf == NULL || len < 12)
+	{
+		if(lpbuf != NULL)
+		{
+			pfree(lpbuf);
+		}
+		return -1;
+	}
 
 	// get http status code
 	memset(status_code,0,sizeof(status_code));
 	strncpy(status_code,lpbuf+9,3);
 	if(atoi(status_code)!=200)
 	{
+		pfree(lpbuf);
 		return -1;
 	}
 
+	// copy the body after the headers into PilotScopeQueryContext
+	if(response != NULL)
+	{
+		char* body = NULL;
+		int body_len;
+		int i;
+
+		for(i = 0; i + 4 <= len; i++)
+		{
+			if(memcmp(lpbuf+i,"\r\n\r\n",4) == 0)
+			{
+				body = lpbuf+i+4;
+				break;
+			}
+		}
+		body_len = body == NULL ? 0 : lpbuf+len-body;
+		*response = (char*)MemoryContextAlloc(PilotScopeQueryContext,body_len+1);
+		if(body_len > 0)
+		{
+			memcpy(*response,body,body_len);
+		}
+		(*response)[body_len] = '\0';
+	}
+
+	pfree(lpbuf);
 	return 0;
 }
\ No newline at end of file
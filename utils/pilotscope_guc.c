@@ -0,0 +1,351 @@
+/*-------------------------------------------------------------------------
+ *
+ * pilotscope_guc.c
+ *	  Routines to define the GUCs of pilotscope.
+ *
+ * Anchors are decided query by query in the json prefix, while the following
+ * settings change how our optimizer works and are set like any other GUC, e.g.
+ * "SET pilotscope.join_enumerator = dpsize;". All of them are defined in
+ * _PG_init and their default values keep the behavior of the standard planner.
+ *
+ * GUCs:
+ *      pilotscope.join_enumerator
+ *      pilotscope.enable_bounded_pruning
+ *      pilotscope.bounded_pruning_factor
+ *      pilotscope.partition_sample_size
+ *      pilotscope.enable_partitionwise_join_template
+ *      pilotscope.enable_partition_scan_template
+ *      pilotscope.enable_relation_info_cache
+ *      pilotscope.enable_predicate_proof_cache
+ *      pilotscope.enable_const_folding_cache
+ *      pilotscope.enable_join_removal_worklist
+ *      pilotscope.enable_pathkey_registry
+ *      pilotscope.enable_path_dominance_index
+ *      pilotscope.enable_greedy_join_search
+ *      pilotscope.greedy_join_window
+ *      pilotscope.enable_scan_cost_cache
+ *      pilotscope.enable_hash_join_stats_cache
+ *      pilotscope.enable_cost_provider
+ *      pilotscope.cost_model_file
+ *      pilotscope.enable_card_model
+ *      pilotscope.card_model_file
+ *      pilotscope.enable_card_callback
+ *
+ * Copyright (c) 2023, Damo Academy of Alibaba Group
+ * -------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <limits.h>
+
+#include "utils/guc.h"
+#include "pilotscope_guc.h"
+#include "cost_provider.h"
+
+/*
+ * The values of pilotscope.join_enumerator, see join_search_one_level in
+ * "optimizer/path/joinrels.c" and standard_join_search in "optimizer/path/allpaths.c".
+ */
+static const struct config_enum_entry join_enumerator_options[] = {
+    {"standard", JOIN_ENUMERATOR_STANDARD, false},
+    {"dpsize", JOIN_ENUMERATOR_DPSIZE, false},
+    {"dpccp", JOIN_ENUMERATOR_DPCCP, false},
+    {NULL, 0, false}
+};
+
+int join_enumerator = JOIN_ENUMERATOR_STANDARD;
+bool enable_bounded_pruning = false;
+double bounded_pruning_factor = 1.0;
+int partition_sample_size = 0;
+bool enable_partitionwise_join_template = false;
+bool enable_partition_scan_template = false;
+bool enable_relation_info_cache = false;
+bool enable_predicate_proof_cache = false;
+bool enable_const_folding_cache = false;
+bool enable_join_removal_worklist = false;
+bool enable_pathkey_registry = false;
+bool enable_path_dominance_index = false;
+bool enable_greedy_join_search = false;
+int greedy_join_window = 5;
+bool enable_scan_cost_cache = false;
+bool enable_hash_join_stats_cache = false;
+bool enable_cost_provider = false;
+char* cost_model_file = NULL;
+bool enable_card_model = false;
+char* card_model_file = NULL;
+bool enable_card_callback = false;
+
+// define all of the gucs of pilotscope
+void define_pilotscope_gucs()
+{
+    DefineCustomEnumVariable("pilotscope.join_enumerator",
+                             "Sets the way to enumerate the join rels of each level of the join search.",
+                             "dpsize collects the candidate pairs of a level first and builds them "
+                             "grouped by join rel. dpccp only builds pairs of connected subgraphs "
+                             "of the join graph.",
+                             &join_enumerator,
+                             JOIN_ENUMERATOR_STANDARD,
+                             join_enumerator_options,
+                             PGC_USERSET,
+                             0,
+                             NULL,
+                             NULL,
+                             NULL);
+
+    DefineCustomBoolVariable("pilotscope.enable_bounded_pruning",
+                             "Prunes join paths that cost more than a greedy join order.",
+                             "The greedy join order is built first with the cardinalities of "
+                             "card_replace_anchor, see standard_join_search in \"optimizer/path/allpaths.c\".",
+                             &enable_bounded_pruning,
+                             false,
+                             PGC_USERSET,
+                             0,
+                             NULL,
+                             NULL,
+                             NULL);
+
+    DefineCustomRealVariable("pilotscope.bounded_pruning_factor",
+                             "Sets the factor applied to the cost of the greedy join order before pruning.",
+                             "Values above 1 leave room for paths whose inputs cost more than the join "
+                             "itself, such as merge joins that stop early.",
+                             &bounded_pruning_factor,
+                             1.0,
+                             1.0,
+                             1.0e10,
+                             PGC_USERSET,
+                             0,
+                             NULL,
+                             NULL,
+                             NULL);
+
+    DefineCustomIntVariable("pilotscope.partition_sample_size",
+                            "Sets the number of children of an append relation whose size is estimated one by one.",
+                            "The sizes of the other plain table children are derived from the selectivity of "
+                            "these representative children. Zero estimates every child.",
+                            &partition_sample_size,
+                            0,
+                            0,
+                            INT_MAX,
+                            PGC_USERSET,
+                            0,
+                            NULL,
+                            NULL,
+                            NULL);
+
+    DefineCustomBoolVariable("pilotscope.enable_partitionwise_join_template",
+                             "Reuses the join methods of the first child join for similar siblings.",
+                             "In a partitionwise join, the child joins whose inputs are about as large as "
+                             "those of the first one only try the join methods that survived for it, "
+                             "see try_partitionwise_join in \"optimizer/path/joinrels.c\".",
+                             &enable_partitionwise_join_template,
+                             false,
+                             PGC_USERSET,
+                             0,
+                             NULL,
+                             NULL,
+                             NULL);
+
+    DefineCustomBoolVariable("pilotscope.enable_partition_scan_template",
+                             "Reuses the index choice of the first child for similar siblings.",
+                             "The children of an append relation with the same indexes and about the same "
+                             "size as the first one only match the indexes its surviving paths use, "
+                             "see set_append_rel_pathlist in \"optimizer/path/allpaths.c\".",
+                             &enable_partition_scan_template,
+                             false,
+                             PGC_USERSET,
+                             0,
+                             NULL,
+                             NULL,
+                             NULL);
+
+    DefineCustomBoolVariable("pilotscope.enable_relation_info_cache",
+                             "Caches the indexes and extended statistics of relations across planning.",
+                             "Entries are dropped by relcache invalidations and rebuilt when the size "
+                             "estimate of the relation changes, see get_relation_info in "
+                             "\"optimizer/util/plancat.c\".",
+                             &enable_relation_info_cache,
+                             false,
+                             PGC_USERSET,
+                             0,
+                             NULL,
+                             NULL,
+                             NULL);
+
+    DefineCustomBoolVariable("pilotscope.enable_predicate_proof_cache",
+                             "Remembers the results of predicate proofs during planning.",
+                             "Proofs for partial indexes and constraint exclusion are looked up by "
+                             "content, and inputs that share no column are not attempted, see "
+                             "lookup_predicate_proof in \"optimizer/util/predtest.c\".",
+                             &enable_predicate_proof_cache,
+                             false,
+                             PGC_USERSET,
+                             0,
+                             NULL,
+                             NULL,
+                             NULL);
+
+    DefineCustomBoolVariable("pilotscope.enable_const_folding_cache",
+                             "Caches inlined SQL function bodies and folded immutable function calls.",
+                             "Both caches live as long as the backend and are dropped when a function, "
+                             "operator, type, cast or schema changes, see inline_function and "
+                             "evaluate_function in \"optimizer/util/clauses.c\".",
+                             &enable_const_folding_cache,
+                             false,
+                             PGC_USERSET,
+                             0,
+                             NULL,
+                             NULL,
+                             NULL);
+
+    DefineCustomBoolVariable("pilotscope.enable_join_removal_worklist",
+                             "Only rechecks the left joins a join removal may affect.",
+                             "The same joins are removed as by the standard planner, see "
+                             "remove_useless_joins_worklist in \"optimizer/plan/analyzejoins.c\".",
+                             &enable_join_removal_worklist,
+                             false,
+                             PGC_USERSET,
+                             0,
+                             NULL,
+                             NULL,
+                             NULL);
+
+    DefineCustomBoolVariable("pilotscope.enable_pathkey_registry",
+                             "Looks canonical pathkeys up by hash and interns pathkey lists.",
+                             "Paths with the same ordering then share one pathkey list, so comparing "
+                             "their pathkeys is a pointer comparison, see intern_pathkeys in "
+                             "\"optimizer/path/pathkeys.c\".",
+                             &enable_pathkey_registry,
+                             false,
+                             PGC_USERSET,
+                             0,
+                             NULL,
+                             NULL,
+                             NULL);
+
+    DefineCustomBoolVariable("pilotscope.enable_path_dominance_index",
+                             "Groups the paths of large pathlists by pathkeys and parameterization.",
+                             "add_path then skips the old paths that can neither dominate nor be "
+                             "dominated by the new path, see get_path_dominance_index in "
+                             "\"optimizer/util/pathnode.c\".",
+                             &enable_path_dominance_index,
+                             false,
+                             PGC_USERSET,
+                             0,
+                             NULL,
+                             NULL,
+                             NULL);
+
+    DefineCustomBoolVariable("pilotscope.enable_greedy_join_search",
+                             "Replaces GEQO by a greedy join ordering refined with dynamic programming.",
+                             "Above geqo_threshold, the join order follows the join sizes, including "
+                             "injected cardinalities, see greedy_join_search in "
+                             "\"optimizer/path/allpaths.c\".",
+                             &enable_greedy_join_search,
+                             false,
+                             PGC_USERSET,
+                             0,
+                             NULL,
+                             NULL,
+                             NULL);
+
+    DefineCustomIntVariable("pilotscope.greedy_join_window",
+                            "Sets the number of inputs whose join order the greedy join search optimizes at once.",
+                            "Each window of the greedy join tree is planned by exhaustive dynamic programming.",
+                            &greedy_join_window,
+                            5,
+                            2,
+                            10,
+                            PGC_USERSET,
+                            0,
+                            NULL,
+                            NULL,
+                            NULL);
+
+    DefineCustomBoolVariable("pilotscope.enable_scan_cost_cache",
+                             "Remembers the inputs of scan costing for the rest of the planning cycle.",
+                             "Tablespace page costs, the cost of pushed-down clauses and the results "
+                             "of amcostestimate are computed once, see get_scan_cost_cache_entry in "
+                             "\"optimizer/path/costsize.c\".",
+                             &enable_scan_cost_cache,
+                             false,
+                             PGC_USERSET,
+                             0,
+                             NULL,
+                             NULL,
+                             NULL);
+
+    DefineCustomBoolVariable("pilotscope.enable_hash_join_stats_cache",
+                             "Shares the inner side estimates of hash join costing between paths.",
+                             "The bucket size, MCV frequency and hash table size of an inner rel are "
+                             "computed once per hash clause set, see get_hash_join_stats_entry in "
+                             "\"optimizer/path/costsize.c\".",
+                             &enable_hash_join_stats_cache,
+                             false,
+                             PGC_USERSET,
+                             0,
+                             NULL,
+                             NULL,
+                             NULL);
+
+    DefineCustomBoolVariable("pilotscope.enable_cost_provider",
+                             "Lets a cost model replace the costs of the cost formulas.",
+                             "The model is the provider another extension installed or else the linear "
+                             "model of pilotscope.cost_model_file, see \"utils/cost_provider.c\".",
+                             &enable_cost_provider,
+                             false,
+                             PGC_USERSET,
+                             0,
+                             NULL,
+                             NULL,
+                             NULL);
+
+    DefineCustomStringVariable("pilotscope.cost_model_file",
+                               "Sets the file holding the weights of the linear cost model.",
+                               "It is read into shared memory at server start if pilotscope is preloaded, "
+                               "and by each backend when it changes.",
+                               &cost_model_file,
+                               "",
+                               PGC_SIGHUP,
+                               0,
+                               NULL,
+                               assign_cost_model_file,
+                               NULL);
+
+    DefineCustomBoolVariable("pilotscope.enable_card_model",
+                             "Estimates the rows of base and join rels with the cardinality model.",
+                             "Cardinalities given by card_replace_anchor still take precedence, see "
+                             "\"utils/card_model.c\".",
+                             &enable_card_model,
+                             false,
+                             PGC_USERSET,
+                             0,
+                             NULL,
+                             NULL,
+                             NULL);
+
+    DefineCustomStringVariable("pilotscope.card_model_file",
+                               "Sets the file holding the gradient-boosted trees of the cardinality model.",
+                               "Each backend reads it when first needed and whenever this setting changes.",
+                               &card_model_file,
+                               "",
+                               PGC_SUSET,
+                               0,
+                               NULL,
+                               NULL,
+                               NULL);
+
+    DefineCustomBoolVariable("pilotscope.enable_card_callback",
+                             "Asks the python side for the cardinalities of the subqueries while planning.",
+                             "The subqueries of the base rels and of each level of the join search are "
+                             "sent in one request each, see \"utils/card_callback.c\".",
+                             &enable_card_callback,
+                             false,
+                             PGC_USERSET,
+                             0,
+                             NULL,
+                             NULL,
+                             NULL);
+
+    EmitWarningsOnPlaceholders("pilotscope");
+}
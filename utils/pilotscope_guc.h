@@ -0,0 +1,48 @@
+/*-------------------------------------------------------------------------
+ *
+ * pilotscope_guc.h
+ *	  prototypes for pilotscope_guc.c.
+ *
+ * Copyright (c) 2023, Damo Academy of Alibaba Group
+ * 
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef __PILOTSCOPE_GUC__
+#define __PILOTSCOPE_GUC__
+
+// the ways to enumerate the join rels of one level
+typedef enum 
+{
+    JOIN_ENUMERATOR_STANDARD,
+    JOIN_ENUMERATOR_DPSIZE,
+    JOIN_ENUMERATOR_DPCCP
+}JoinEnumerator;
+
+// gucs
+extern int join_enumerator;
+extern bool enable_bounded_pruning;
+extern double bounded_pruning_factor;
+extern int partition_sample_size;
+extern bool enable_partitionwise_join_template;
+extern bool enable_partition_scan_template;
+extern bool enable_relation_info_cache;
+extern bool enable_predicate_proof_cache;
+extern bool enable_const_folding_cache;
+extern bool enable_join_removal_worklist;
+extern bool enable_pathkey_registry;
+extern bool enable_path_dominance_index;
+extern bool enable_greedy_join_search;
+extern int greedy_join_window;
+extern bool enable_scan_cost_cache;
+extern bool enable_hash_join_stats_cache;
+extern bool enable_cost_provider;
+extern char* cost_model_file;
+extern bool enable_card_model;
+extern char* card_model_file;
+extern bool enable_card_callback;
+
+// function
+extern void define_pilotscope_gucs();
+
+#endif
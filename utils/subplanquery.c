@@ -192,8 +192,12 @@ get_restrictclauses(PlannerInfo *root, List *clauses)
 			isWhereOrAnd = false;
 		}
 			
-        RestrictInfo *c = lfirst(l);
-        get_expr((Node *) c->clause, root->parse->rtable);
+        Node	   *c = (Node *) lfirst(l);
+
+        // clauses of clauselist_selectivity may be bare expressions
+        if (IsA(c, RestrictInfo))
+            c = (Node *) ((RestrictInfo *) c)->clause;
+        get_expr(c, root->parse->rtable);
         if (lnext(clauses, l))
             strcat(sub_query, " and ");
 		first = false;
@@ -349,4 +353,25 @@ get_join_rel (PlannerInfo *root,
 
 	strcat(sub_query, ";");
 	strcat(sub_query, "\0");
-}
\ No newline at end of file
+}
+
+/*
+ * Get the fingerprint of a clause set on the given relations. It is written as a
+ * single-table or multi-table subquery, so that the fingerprint of the whole
+ * baserestrictinfo of a relation is the same as its subquery from get_single_rel. 
+ */
+void
+get_clauselist_rel (PlannerInfo *root, Relids relids, List *clauses)
+{
+	// select
+	strcpy(sub_query, "select count(*) from ");
+
+	// from
+	get_relids(root, relids);
+
+	// where
+	isWhereOrAnd = true;
+	get_restrictclauses(root, clauses);
+
+	strcat(sub_query, "\0");
+}
@@ -20,5 +20,6 @@ extern void get_join_rel (PlannerInfo *root,
 					RelOptInfo *inner_rel,
 					List *restrictlist_in);
 extern void get_single_rel (PlannerInfo *root, RelOptInfo *rel); 
+extern void get_clauselist_rel (PlannerInfo *root, Relids relids, List *clauses);
 
 #endif
\ No newline at end of file